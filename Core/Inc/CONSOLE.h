@@ -0,0 +1,41 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * Scrolling text console. Display RAM is used as a circular buffer of
+ * pages, one text line per page, and new lines are scrolled in with the
+ * display start line so each line costs a single page write.
+ */
+#ifndef INC_CONSOLE_H_
+#define INC_CONSOLE_H_
+
+#include <stdint.h>
+#include "GFX.h"
+
+#define CONSOLE_LINES ((SSD1306_HEIGHT + 7) / 8)
+#define CONSOLE_COLUMNS ((SSD1306_WIDTH + GFX_CHAR_ADVANCE - GFX_CHAR_WIDTH) / GFX_CHAR_ADVANCE)
+
+void CONSOLE_init(void);
+void CONSOLE_write(const char *s);
+void CONSOLE_new_line(void);
+
+#endif /* INC_CONSOLE_H_ */
@@ -0,0 +1,44 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * CRC-32 of RAM blocks on the CRC peripheral, polynomial 0x04C11DB7,
+ * initial value 0xFFFFFFFF, no reflection and no final XOR. Aligned words
+ * go in 32 bits at a time, most significant bit of the word first,
+ * leftover bytes 8 bits at a time. Host builds compute the same value in
+ * software.
+ *
+ * The peripheral holds one computation at a time, use it from thread
+ * context only.
+ */
+#ifndef INC_CRC32_H_
+#define INC_CRC32_H_
+
+#include <stdint.h>
+
+#define CRC32_POLY 0x04C11DB7UL
+#define CRC32_INIT 0xFFFFFFFFUL
+
+void CRC32_init(void);
+uint32_t CRC32_compute(const void *data, uint32_t len);
+
+#endif /* INC_CRC32_H_ */
@@ -0,0 +1,42 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * Minimal printf style formatter shared by the display and serial text
+ * output. Characters are handed to a caller supplied function one at a
+ * time, so no heap, stdio or intermediate string buffer is needed.
+ */
+#ifndef INC_FORMAT_H_
+#define INC_FORMAT_H_
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef void (*FORMAT_put_t)(char c, void *ctx);
+
+void FORMAT_int(FORMAT_put_t put, void *ctx, int32_t value, uint8_t width);
+void FORMAT_hex(FORMAT_put_t put, void *ctx, uint32_t value, uint8_t digits);
+void FORMAT_fixed(FORMAT_put_t put, void *ctx, int32_t value, uint8_t decimals);
+void FORMAT_vprint(FORMAT_put_t put, void *ctx, const char *fmt, va_list args);
+
+#endif /* INC_FORMAT_H_ */
@@ -55,14 +55,67 @@ POSSIBILITY OF SUCH DAMAGE.
 #ifndef INC_GFX_H_
 #define INC_GFX_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 #include "SSD1306.h"
 
 #define WIDTH SSD1306_WIDTH
 #define HEIGHT SSD1306_HEIGHT
 
+/* Glyph cache, holds decoded glyphs as ready-to-OR page columns */
+#ifndef GFX_GLYPH_CACHE_SIZE
+#define GFX_GLYPH_CACHE_SIZE 16		//< Cached glyphs, 0 disables the cache
+#endif
+#define GFX_GLYPH_CACHE_PAGES 3		//< Max pages spanned by a cached glyph
+
+typedef struct
+{
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t evictions;
+} GFX_glyph_cache_stats_t;
+
+/* Built-in font metrics, in unscaled pixels */
+#define GFX_CHAR_WIDTH 5		//< Glyph columns
+#define GFX_CHAR_ADVANCE 7		//< Glyph plus spacing
+#define GFX_CHAR_HEIGHT 8		//< Character cell and line height
+
+/* Text layout flags */
+#define GFX_ALIGN_LEFT 0x00
+#define GFX_ALIGN_CENTER 0x01
+#define GFX_ALIGN_RIGHT 0x02
+#define GFX_ALIGN_MASK 0x03
+#define GFX_TEXT_WRAP 0x04		//< Word wrap into the box width
+#define GFX_TEXT_ELLIPSIS 0x08	//< End truncated text with "..."
+
+typedef struct
+{
+	uint16_t start;		//< Index of the first character of the line
+	uint16_t len;		//< Characters on the line, without ellipsis
+	int16_t x;			//< Left edge relative to the box
+	bool ellipsis;		//< Line is followed by "..."
+} GFX_text_line_t;
+
 void GFX_draw_char(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size_x, uint8_t size_y);
 void GFX_draw_string(int16_t x, int16_t y, unsigned char * c, uint16_t color, uint16_t bg, uint8_t size_x, uint8_t size_y);
 void GFX_draw_fill_rect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+int16_t GFX_get_text_width(const unsigned char *c, uint16_t len, uint8_t size_x);
+void GFX_get_text_bounds(const unsigned char *c, uint8_t size_x, uint8_t size_y, int16_t *w, int16_t *h);
+uint8_t GFX_layout_text(const unsigned char *c, int16_t w, int16_t h, uint8_t size_x, uint8_t size_y, uint8_t flags, GFX_text_line_t *lines, uint8_t max_lines);
+uint8_t GFX_draw_text_box(int16_t x, int16_t y, int16_t w, int16_t h, const unsigned char *c, uint16_t color, uint16_t bg, uint8_t size_x, uint8_t size_y, uint8_t flags);
+void GFX_set_cursor(int16_t x, int16_t y);
+void GFX_get_cursor(int16_t *x, int16_t *y);
+void GFX_set_text_color(uint16_t color, uint16_t bg);
+void GFX_set_text_size(uint8_t size_x, uint8_t size_y);
+void GFX_set_text_wrap(bool wrap);
+void GFX_write(unsigned char c);
+void GFX_print(const char *s);
+void GFX_print_int(int32_t value, uint8_t width);
+void GFX_print_hex(uint32_t value, uint8_t digits);
+void GFX_print_fixed(int32_t value, uint8_t decimals);
+void GFX_printf(const char *fmt, ...);
+void GFX_set_fast_paths(bool enable);
+void GFX_glyph_cache_flush(void);
+void GFX_glyph_cache_get_stats(GFX_glyph_cache_stats_t *stats);
 
 #endif /* INC_GFX_H_ */
@@ -0,0 +1,125 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * Shared I2C bus manager. Devices queue transactions instead of calling
+ * HAL directly, the manager runs them one at a time per bus from the
+ * transfer complete interrupt, highest priority first and in order within
+ * a priority. Buses run independently of each other, I2C1 on DMA1
+ * channel 6 and, with I2CBUS_I2C2, I2C2 on DMA1 channel 4 (PA9 SCL,
+ * PA10 SDA).
+ *
+ * A transaction may be split into chunks, each a bus transaction of its
+ * own with the same register, so a long display write gives way to
+ * higher priority reads between chunks. A high priority transaction then
+ * waits for at most one chunk.
+ *
+ * Writes go by DMA. Reads are interrupt driven, the I2C1_RX request line
+ * (DMA1 channel 7) carries USART2 TX and I2C2_RX (channel 5) is left
+ * free.
+ *
+ * With I2CBUS_LL set, writes with a one byte register are driven straight
+ * from the I2C and DMA registers, skipping the HAL state checks, locking
+ * and tick timeouts that dominate short command writes. The HAL handle
+ * stays idle meanwhile. Reads and two byte registers still use HAL.
+ */
+#ifndef INC_I2CBUS_H_
+#define INC_I2CBUS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef I2CBUS_LL
+#define I2CBUS_LL 0
+#endif
+
+#ifndef I2CBUS_I2C2
+#define I2CBUS_I2C2 0	//< Set to 1 to bring up I2C2 as a second bus
+#endif
+
+typedef enum
+{
+	I2CBUS_BUS1,			//< I2C1
+#if I2CBUS_I2C2
+	I2CBUS_BUS2,			//< I2C2
+#endif
+	I2CBUS_BUSES
+} I2CBUS_bus_id_t;
+
+typedef enum
+{
+	I2CBUS_PRIO_HIGH,		//< Latency bound reads, e.g. sensors
+	I2CBUS_PRIO_NORMAL,
+	I2CBUS_PRIO_LOW,		//< Bulk transfers, e.g. display frames
+	I2CBUS_PRIO_COUNT
+} I2CBUS_prio_t;
+
+typedef struct I2CBUS_xfer_s I2CBUS_xfer_t;
+
+/*
+ * Called from the main loop once the whole transaction is done, see
+ * SCHED_complete(). Runs of a transaction resubmitted before the call
+ * share one, ok is false if any of them failed.
+ */
+typedef void (*I2CBUS_done_t)(I2CBUS_xfer_t *xfer, bool ok);
+
+struct I2CBUS_xfer_s
+{
+	uint8_t bus;			//< I2CBUS_bus_id_t
+	uint16_t addr;			//< Device address, shifted left as for HAL
+	uint16_t reg;			//< Register, or control byte
+	uint8_t reg_size;		//< Register bytes, 1 or 2
+	bool read;
+	uint8_t prio;			//< I2CBUS_prio_t
+	uint8_t *data;
+	uint16_t len;
+	uint16_t chunk;			//< Largest piece per bus transaction, 0 for all
+	I2CBUS_done_t done;		//< May be NULL
+	void *ctx;				//< For the done callback
+
+	/* Owned by the bus manager while pending */
+	volatile bool pending;
+	uint16_t offset;
+	uint32_t queued;
+	I2CBUS_xfer_t *next;
+	bool ok;				//< Result waiting for the done call
+	bool reporting;			//< On the done list
+	I2CBUS_xfer_t *done_next;
+};
+
+typedef struct
+{
+	uint32_t transfers;		//< Completed transactions
+	uint32_t chunks;		//< Bus transactions they took
+	uint32_t errors;
+	uint32_t max_wait[I2CBUS_PRIO_COUNT];	//< Longest queue wait, cycles
+} I2CBUS_stats_t;
+
+bool I2CBUS_submit(I2CBUS_xfer_t *xfer);
+bool I2CBUS_pending(const I2CBUS_xfer_t *xfer);
+void I2CBUS_wait(const I2CBUS_xfer_t *xfer);
+bool I2CBUS_busy(uint8_t bus);
+void I2CBUS_get_stats(uint8_t bus, I2CBUS_stats_t *out);
+void I2CBUS_reset_stats(void);
+void I2CBUS_irq_handler(uint8_t bus);
+
+#endif /* INC_I2CBUS_H_ */
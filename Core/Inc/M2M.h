@@ -0,0 +1,53 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * Memory to memory DMA on DMA2 channel 1, which no peripheral uses here.
+ * Fills, copies and copies of a rectangle out of a larger array run in
+ * the background and report back once done.
+ * The channel has the lowest DMA priority, display and serial transfers
+ * go first.
+ *
+ * One operation runs at a time, starting another waits for it. The done
+ * callback runs from the main loop, see SCHED_complete(), and may start
+ * the next one. Word aligned blocks move 32 bits per
+ * transfer, the rest a byte at a time. Host builds do the work before
+ * returning.
+ */
+#ifndef INC_M2M_H_
+#define INC_M2M_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Called from the main loop once the operation is done, directly on the host */
+typedef void (*M2M_done_t)(void *ctx);
+
+void M2M_init(void);
+void M2M_fill(void *dst, uint8_t value, uint32_t len, M2M_done_t done, void *ctx);
+void M2M_copy(void *dst, const void *src, uint32_t len, M2M_done_t done, void *ctx);
+void M2M_copy_rect(void *dst, uint16_t dst_stride, const void *src, uint16_t src_stride, uint16_t width, uint16_t rows, M2M_done_t done, void *ctx);
+bool M2M_busy(void);
+void M2M_wait(void);
+void M2M_irq_handler(void);
+
+#endif /* INC_M2M_H_ */
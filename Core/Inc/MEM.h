@@ -0,0 +1,52 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * RAM usage: static data, newlib heap handed out by _sbrk() and the main
+ * stack. Reset_Handler paints all RAM above the static data with
+ * MEM_PAINT, the stack high water mark is the lowest overwritten word
+ * above the heap.
+ */
+#ifndef INC_MEM_H_
+#define INC_MEM_H_
+
+#include <stdint.h>
+
+#define MEM_PAINT 0xA5A5A5A5UL	//< Must match Reset_Handler in startup_stm32f303retx.s
+
+typedef struct
+{
+	uint32_t ram;			//< Total RAM
+	uint32_t static_used;	//< .data and .bss
+	uint32_t heap_used;
+	uint32_t heap_peak;
+	uint32_t heap_failed;	//< Allocations refused by _sbrk()
+	uint32_t stack_used;	//< Stack in use by the caller
+	uint32_t stack_peak;	//< Stack high water mark
+	uint32_t free;			//< Never touched by heap or stack
+} MEM_stats_t;
+
+uint32_t MEM_stack_high_water(void);
+void MEM_get_stats(MEM_stats_t *stats);
+void MEM_report(void);
+
+#endif /* INC_MEM_H_ */
@@ -0,0 +1,105 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * Cycle counting profiler. PROF_BEGIN()/PROF_END() pairs around a hot
+ * path accumulate call count, total/min/max DWT cycles and a log2 latency
+ * histogram per profiling point. Times of nested points are inclusive.
+ *
+ * Build with PROF_ENABLE 0 to compile every probe out. Host builds
+ * (without USE_HAL_DRIVER) have no cycle counter and always do.
+ *
+ * Each point must only be recorded from one context, either thread or a
+ * single interrupt, so recording needs no locking.
+ */
+#ifndef INC_PROF_H_
+#define INC_PROF_H_
+
+#include <stdint.h>
+
+#ifndef PROF_ENABLE
+#define PROF_ENABLE 1
+#endif
+#ifndef USE_HAL_DRIVER
+#undef PROF_ENABLE
+#define PROF_ENABLE 0
+#endif
+
+#define PROF_HIST_BUCKETS 24	//< Bucket n counts [2^(n-1), 2^n) cycles, the last one everything above
+
+typedef enum
+{
+	PROF_DRAW_CHAR,
+	PROF_DRAW_STRING,
+	PROF_DRAW_TEXT_BOX,
+	PROF_FILL_RECT,
+	PROF_HLINE,
+	PROF_VLINE,
+	PROF_CLEAR,
+	PROF_REPAINT,			//< CPU time to start a repaint
+	PROF_REPAINT_PAGE,
+	PROF_I2C_TRANSFER,		//< DMA start to transfer complete callback
+	PROF_I2C_ERROR,			//< DMA start to error callback
+	PROF_IRQ_SYSTICK,
+	PROF_IRQ_I2C1_DMA,
+	PROF_IRQ_I2C1_EV,
+	PROF_IRQ_USART2,
+	PROF_IRQ_USART2_DMA,
+	PROF_IRQ_EXTI15_10,
+	PROF_IRQ_I2C2_DMA,
+	PROF_IRQ_I2C2_EV,
+	PROF_IRQ_M2M_DMA,
+	PROF_POINTS
+} PROF_point_t;
+
+typedef struct
+{
+	uint32_t count;
+	uint64_t total;
+	uint32_t min;
+	uint32_t max;
+	uint32_t hist[PROF_HIST_BUCKETS];
+} PROF_stat_t;
+
+#ifdef USE_HAL_DRIVER
+#include "main.h"
+#define PROF_CYCLES() (DWT->CYCCNT)
+#else
+#define PROF_CYCLES() 0
+#endif
+
+#if PROF_ENABLE
+#define PROF_BEGIN(id) uint32_t prof_start_##id = PROF_CYCLES()
+#define PROF_END(id) PROF_record((id), PROF_CYCLES() - prof_start_##id)
+#else
+#define PROF_BEGIN(id)
+#define PROF_END(id)
+#endif
+
+void PROF_init(void);
+void PROF_reset(void);
+void PROF_record(PROF_point_t id, uint32_t cycles);
+void PROF_get(PROF_point_t id, PROF_stat_t *stat);
+const char * PROF_get_name(PROF_point_t id);
+void PROF_dump(void);
+
+#endif /* INC_PROF_H_ */
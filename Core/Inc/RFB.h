@@ -0,0 +1,72 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * Remote frame buffer. A host streams frames over the serial port which
+ * are decoded straight into the display buffer and repainted.
+ *
+ * Frame layout, multi-byte fields little endian:
+ *
+ *   0xA5 0x5A | type | length (2) | payload (length) | CRC-16 (2)
+ *
+ * CRC-16/CCITT-FALSE covers type, length and payload. Payload by type:
+ *
+ *   RFB_FRAME_FULL   Whole buffer, page by page as in SSD1306_get_buffer()
+ *   RFB_FRAME_RLE    Whole buffer, run length coded: control byte c < 0x80
+ *                    is followed by c + 1 literal bytes, c >= 0x80 by one
+ *                    byte repeated c - 0x80 + 2 times
+ *   RFB_FRAME_DELTA  Patches of page, column, count (1..255) and count
+ *                    bytes written from that page and column onwards
+ *
+ * Each frame is answered with RFB_ACK, or RFB_NAK if it was corrupt. Full
+ * and RLE frames that do not fill exactly the whole buffer are corrupt.
+ */
+#ifndef INC_RFB_H_
+#define INC_RFB_H_
+
+#include <stdint.h>
+#include "SSD1306.h"
+
+#define RFB_SYNC1 0xA5
+#define RFB_SYNC2 0x5A
+
+#define RFB_FRAME_FULL 0x01
+#define RFB_FRAME_RLE 0x02
+#define RFB_FRAME_DELTA 0x03
+
+#define RFB_ACK 0x06
+#define RFB_NAK 0x15
+
+#define RFB_MAX_PAYLOAD 2048
+
+typedef struct
+{
+	uint32_t frames;		//< Frames decoded and repainted
+	uint32_t errors;		//< Frames rejected for CRC, length or bounds
+} RFB_stats_t;
+
+void RFB_init(void);
+uint16_t RFB_feed(const uint8_t *data, uint16_t len);
+void RFB_process(void);
+void RFB_get_stats(RFB_stats_t *s);
+
+#endif /* INC_RFB_H_ */
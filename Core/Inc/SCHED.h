@@ -0,0 +1,97 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * Cooperative run to completion scheduler for the main loop. Work comes
+ * in three forms, all run from thread context by SCHED_run_once():
+ *
+ * - deferred callbacks, queued with SCHED_post() from anywhere, including
+ *   interrupt handlers. I2CBUS, M2M and SERIAL hand their transfer
+ *   completions over this way with SCHED_complete(), so done callbacks
+ *   run in the main loop;
+ * - timers on the HAL tick, one-shot or periodic;
+ * - pollers, called once per pass, for modules that read their input
+ *   themselves such as TERM_process().
+ *
+ * Callbacks must return quickly, long work is split up by posting the
+ * rest. SSD1306 repaints asked for while the previous frame is still on
+ * the bus go out from its completion, instead of waiting for it. Panel
+ * commands, banded stripes and images still wait for the bus. When
+ * nothing is queued or due the CPU sleeps (WFI) until the next
+ * interrupt, SysTick at the latest, with SCHED_SLEEP set. DMA transfers
+ * carry on meanwhile.
+ *
+ * Code busy waiting in thread context holds up the posted completions,
+ * so it must not wait for a done callback.
+ */
+#ifndef INC_SCHED_H_
+#define INC_SCHED_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef SCHED_QUEUE
+#define SCHED_QUEUE 16		//< Deferred callbacks waiting at most
+#endif
+#ifndef SCHED_POLLS
+#define SCHED_POLLS 4
+#endif
+#ifndef SCHED_SLEEP
+#define SCHED_SLEEP 1		//< Set to 0 to spin instead, e.g. for debug probes that lose sleeping cores
+#endif
+
+typedef void (*SCHED_fn_t)(void *ctx);
+typedef void (*SCHED_poll_t)(void);
+
+typedef struct SCHED_timer_s SCHED_timer_t;
+
+struct SCHED_timer_s
+{
+	/* Owned by the scheduler while active */
+	SCHED_fn_t fn;
+	void *ctx;
+	uint32_t due;			//< HAL tick
+	uint32_t period;		//< ms, 0 for one-shot
+	bool active;
+	SCHED_timer_t *next;
+};
+
+typedef struct
+{
+	uint32_t posted;		//< Deferred callbacks run
+	uint32_t dropped;		//< SCHED_post() calls refused, queue full
+	uint32_t max_queued;	//< Deepest the queue has been
+	uint32_t timers;		//< Timer callbacks run
+	uint32_t passes;		//< SCHED_run_once() calls
+	uint32_t sleeps;		//< Passes that ended in WFI
+} SCHED_stats_t;
+
+bool SCHED_post(SCHED_fn_t fn, void *ctx);
+void SCHED_complete(SCHED_fn_t fn, void *ctx);
+void SCHED_timer_start(SCHED_timer_t *t, SCHED_fn_t fn, void *ctx, uint32_t delay_ms, uint32_t period_ms);
+void SCHED_timer_stop(SCHED_timer_t *t);
+bool SCHED_add_poll(SCHED_poll_t fn);
+void SCHED_run_once(void);
+void SCHED_get_stats(SCHED_stats_t *out);
+void SCHED_report(void);
+
+#endif /* INC_SCHED_H_ */
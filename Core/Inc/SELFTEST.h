@@ -0,0 +1,65 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * Display throughput self-test. Cycles test patterns through
+ * SSD1306_display_repaint() and reports frames per second, bytes per
+ * second, I2C busy fraction and draw versus transfer time, measured with
+ * the DWT cycle counter and the HAL tick, on the panel and over USART2.
+ * Used to qualify display modules and cabling for a target refresh rate.
+ * Also compares the cycles per pixel of byte read-modify-write and
+ * bit-band pixel drawing.
+ */
+#ifndef INC_SELFTEST_H_
+#define INC_SELFTEST_H_
+
+#include <stdint.h>
+#include "SSD1306.h"
+
+#ifndef SELFTEST_PATTERN_MS
+#define SELFTEST_PATTERN_MS 2000	//< Run time of each test pattern
+#endif
+#define SELFTEST_RESULT_MS 5000		//< Results stay on the panel this long
+
+/*
+ * Bytes on the wire per full repaint: 6 address window commands of
+ * address, control and command byte, then address, control and the
+ * frame buffer.
+ */
+#define SELFTEST_FRAME_BYTES (6 * 3 + 2 + SSD1306_WIDTH * ((SSD1306_HEIGHT + 7) / 8))
+
+typedef struct
+{
+	const char *name;
+	uint32_t frames;
+	uint32_t ms;			//< Elapsed HAL ticks
+	uint32_t fps_x10;		//< Frames per second, one decimal
+	uint32_t bytes_per_s;
+	uint8_t busy_pct;		//< Share of the run time the bus was busy
+	uint32_t draw_us;		//< Mean drawing time per frame
+	uint32_t xfer_us;		//< Mean transfer time per frame
+} SELFTEST_result_t;
+
+void SELFTEST_run(void);
+const SELFTEST_result_t * SELFTEST_get_results(uint8_t *count);
+
+#endif /* INC_SELFTEST_H_ */
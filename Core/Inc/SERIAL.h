@@ -0,0 +1,56 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * USART2 byte stream shared by the serial front ends. Reception is
+ * interrupt driven into a ring buffer: DMA1 channel 6, the USART2_RX
+ * request line, is taken by I2C1_TX for the display. Transmission uses
+ * DMA1 channel 7.
+ */
+#ifndef INC_SERIAL_H_
+#define INC_SERIAL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "usart.h"
+
+#define SERIAL_UART huart2
+
+#ifndef SERIAL_RX_BUFFER_SIZE
+#define SERIAL_RX_BUFFER_SIZE 256	//< Must be a power of two
+#endif
+
+typedef void (*SERIAL_tx_done_t)(void *ctx);
+
+void SERIAL_init(void);
+uint16_t SERIAL_available(void);
+uint16_t SERIAL_read(uint8_t *buf, uint16_t len);
+bool SERIAL_rx_idle(void);
+uint32_t SERIAL_get_rx_dropped(void);
+bool SERIAL_write_dma(const uint8_t *buf, uint16_t len, SERIAL_tx_done_t done, void *ctx);
+bool SERIAL_tx_busy(void);
+void SERIAL_write(const uint8_t *buf, uint16_t len);
+void SERIAL_print(const char *s);
+void SERIAL_printf(const char *fmt, ...);
+void SERIAL_irq_handler(void);
+
+#endif /* INC_SERIAL_H_ */
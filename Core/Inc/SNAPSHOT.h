@@ -0,0 +1,58 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * Frame buffer snapshots, as PBM (P4, set pixels are 1) of the frame the
+ * application drew, or as the raw display RAM pages with a 4 byte header
+ * 'F', 'B', width, height.
+ *
+ * On the target snapshots are streamed over the serial port by DMA. Host
+ * builds (without USE_HAL_DRIVER) write them to a file instead, e.g.
+ *
+ *   cc -ICore/Inc app.c Core/Src/SNAPSHOT.c Core/Src/SSD1306.c Core/Src/GFX.c \
+ *      Core/Src/FORMAT.c Core/Src/M2M.c Core/Src/CRC32.c
+ *
+ * tests/Makefile builds the host tests this way.
+ */
+#ifndef INC_SNAPSHOT_H_
+#define INC_SNAPSHOT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "SSD1306.h"
+
+#define SNAPSHOT_FORMAT_PBM 0
+#define SNAPSHOT_FORMAT_RAW 1
+
+#define SNAPSHOT_CHUNK_ROWS 8	//< Rows packed per PBM transfer
+
+uint16_t SNAPSHOT_header(uint8_t format, char *out);
+uint16_t SNAPSHOT_pack_rows(int16_t y, uint8_t rows, uint8_t *out);
+#ifdef USE_HAL_DRIVER
+bool SNAPSHOT_send(uint8_t format);
+bool SNAPSHOT_request(uint8_t format);
+bool SNAPSHOT_busy(void);
+#else
+bool SNAPSHOT_save(const char *path, uint8_t format);
+#endif
+
+#endif /* INC_SNAPSHOT_H_ */
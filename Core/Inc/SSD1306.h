@@ -50,15 +50,94 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include "I2CBUS.h"
 
 #define SSD1306_WIDTH	128
 #define SSD1306_HEIGHT	64
 
 #define SSD1306_I2C_ADDRESS (0x3C << 1)
-#define SSD1306_I2C_BUS hi2c1
+
+/* Transfers go through the I2C bus manager, see I2CBUS.h. Frames are sent
+ * in chunks of SSD1306_I2C_CHUNK bytes so other devices get the bus in
+ * between, 0 sends each frame in one piece.
+ */
+#ifndef SSD1306_I2C_PRIO
+#define SSD1306_I2C_PRIO I2CBUS_PRIO_LOW
+#endif
+#ifndef SSD1306_I2C_CHUNK
+#define SSD1306_I2C_CHUNK SSD1306_WIDTH
+#endif
 
 #define SSD1306_SPI_BUS hspi2
 
+/* Set to 0 to drive the display with SSD1306_render_banded() only, without
+ * allocating a frame buffer. Drawing outside a banded render then has no
+ * effect.
+ */
+#ifndef SSD1306_FRAME_BUFFER
+#define SSD1306_FRAME_BUFFER 1
+#endif
+
+/* Set to 0 to do 180 degree rotation in software instead of flipping the
+ * controller's segment and COM scan order.
+ */
+#ifndef SSD1306_HW_ROTATION
+#define SSD1306_HW_ROTATION 1
+#endif
+
+/* Set to 1 to draw rotations 1 and 3 into an unrotated canvas and rotate
+ * it with an 8x8 bit transpose when repainting, instead of rotating every
+ * pixel. The buffer then no longer has the display RAM layout, which
+ * SSD1306_get_buffer() users such as RFB and raw snapshots expect.
+ */
+#ifndef SSD1306_TRANSPOSE_FLUSH
+#define SSD1306_TRANSPOSE_FLUSH 0
+#endif
+
+/* Set to 1 to keep a CRC of every page the panel was sent, see CRC32.h.
+ * Repaints then leave out unchanged pages and skip unchanged frames.
+ * A canvas is hashed as a whole, SSD1306_display_repaint_page() always
+ * sends it. Call SSD1306_invalidate() when the display RAM changes
+ * behind the driver's back, e.g. after a power cycle of the panel.
+ */
+#ifndef SSD1306_SKIP_UNCHANGED
+#define SSD1306_SKIP_UNCHANGED 0
+#endif
+
+typedef void (*SSD1306_draw_t)(void *ctx);
+typedef void (*SSD1306_done_t)(void *ctx);
+
+/* Host builds (without USE_HAL_DRIVER) pass what would go on the bus to
+ * this, reg is 0x00 for commands and SSD1306_SETSTARTLINE for display
+ * data. Tests use it to model the panel.
+ */
+typedef void (*SSD1306_host_write_t)(uint8_t reg, const uint8_t *buf, uint16_t len);
+
+/* One display. Panels on different buses repaint in parallel, drawing
+ * goes to the panel picked with SSD1306_select_panel(). Rotation and
+ * mirroring are shared by all panels. Fill in bus and address, and
+ * buffer or leave it NULL for SSD1306_init() to allocate, the rest is
+ * owned by the driver.
+ */
+typedef struct SSD1306_panel
+{
+	uint8_t bus;			//< I2CBUS_bus_id_t
+	uint8_t address;		//< Shifted left as SSD1306_I2C_ADDRESS
+	uint8_t *buffer;		//< Frame buffer
+
+	I2CBUS_xfer_t com_xfer, window_xfer, data_xfer;
+	uint8_t window[6];		//< Address window commands, read by DMA
+	volatile bool group;	//< Counted by SSD1306_repaint_all()
+	uint8_t dirty;			//< Bit per page repainted while the last frame was in flight
+	volatile bool stranded;	//< Dirty pages left for the poller, see platform_done()
+	struct SSD1306_panel *next_stranded;
+#if SSD1306_SKIP_UNCHANGED
+	uint32_t page_crc[(SSD1306_HEIGHT + 7) / 8];	//< As last sent, a canvas in [0]
+	uint8_t crc_valid;		//< Bit per page of page_crc
+	volatile bool crc_lost;	//< A transfer failed, the panel may differ
+#endif
+} SSD1306_panel_t;
+
 /* The following "raw" color names are kept for backwards client compatability
  * They can be disabled by predefining this macro before including the Adafruit
  * header client code will then need to be modified to use the scoped enum
@@ -92,7 +171,7 @@
 #define SSD1306_SETMULTIPLEX 0xA8        //< See datasheet
 #define SSD1306_DISPLAYOFF 0xAE          //< See datasheet
 #define SSD1306_DISPLAYON 0xAF           //< See datasheet
-#define SSD1306_COMSCANINC 0xC0          //< Not currently used
+#define SSD1306_COMSCANINC 0xC0          //< See datasheet
 #define SSD1306_COMSCANDEC 0xC8          //< See datasheet
 #define SSD1306_SETDISPLAYOFFSET 0xD3    //< See datasheet
 #define SSD1306_SETDISPLAYCLOCKDIV 0xD5  //< See datasheet
@@ -123,8 +202,23 @@ void SSD1306_draw_fast_hline_internal(int16_t x, int16_t y, int16_t w, uint16_t
 void SSD1306_draw_fast_vline(int16_t x, int16_t y, int16_t h, uint16_t color);
 void SSD1306_draw_fast_vline_internal(int16_t x, int16_t __y, int16_t __h, uint16_t color);
 bool SSD1306_get_pixel(int16_t x, int16_t y);
+void SSD1306_draw_pixel_atomic(int16_t x, int16_t y, uint16_t color);
+bool SSD1306_get_pixel_atomic(int16_t x, int16_t y);
 uint8_t* SSD1306_get_buffer(void);
+void SSD1306_clear_async(uint8_t pattern, SSD1306_done_t done, void *ctx);
+void SSD1306_copy_buffer(uint8_t *dst, const uint8_t *src, SSD1306_done_t done, void *ctx);
+bool SSD1306_save_rect(uint8_t *save, int16_t x, uint8_t page, uint8_t w, uint8_t pages, SSD1306_done_t done, void *ctx);
+bool SSD1306_restore_rect(const uint8_t *save, int16_t x, uint8_t page, uint8_t w, uint8_t pages, SSD1306_done_t done, void *ctx);
+void SSD1306_get_band(int16_t *top, int16_t *bottom);
 void SSD1306_display_repaint(void);
+void SSD1306_display_repaint_page(uint8_t page);
+void SSD1306_invalidate(void);
+bool SSD1306_display_image(const uint8_t *image, uint8_t x, uint8_t page, uint8_t w, uint8_t pages);
+bool SSD1306_display_image_overlay(const uint8_t *image, const uint8_t *overlay, uint8_t x, uint8_t page, uint8_t w, uint8_t pages, uint16_t color);
+bool SSD1306_render_banded(SSD1306_draw_t draw, void *ctx, uint8_t *stripes, uint8_t band_pages, bool ping_pong);
+void SSD1306_set_start_line(uint8_t line);
+bool SSD1306_display_busy(void);
+void SSD1306_display_wait(void);
 void SSD1306_start_scroll_right(uint8_t start, uint8_t stop);
 void SSD1306_start_scroll_left(uint8_t start, uint8_t stop);
 void SSD1306_start_scroll_diagright(uint8_t start, uint8_t stop);
@@ -134,5 +228,15 @@ void SSD1306_display_invert(bool i);
 void SSD1306_set_contrast(uint8_t contrast);
 void SSD1306_set_rotation(uint8_t rot);
 uint8_t SSD1306_get_rotation(void);
+uint8_t SSD1306_get_buffer_rotation(void);
+int16_t SSD1306_get_buffer_width(void);
+void SSD1306_set_mirror(bool x, bool y);
+void SSD1306_select_panel(SSD1306_panel_t *p);
+SSD1306_panel_t* SSD1306_get_panel(void);
+bool SSD1306_repaint_all(SSD1306_panel_t * const *panels, uint8_t count, SSD1306_done_t done, void *ctx);
+bool SSD1306_repaint_all_busy(void);
+#ifndef USE_HAL_DRIVER
+void SSD1306_set_host_write(SSD1306_host_write_t fn);
+#endif
 
 #endif // __SSD1306_H_
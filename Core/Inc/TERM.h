@@ -0,0 +1,48 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * Serial terminal. Bytes received on the serial port are interpreted as
+ * text with a subset of ANSI escape sequences and kept in a character
+ * grid; only cells that changed are redrawn and only their pages sent.
+ */
+#ifndef INC_TERM_H_
+#define INC_TERM_H_
+
+#include <stdint.h>
+#include "GFX.h"
+
+#define TERM_COLUMNS ((SSD1306_WIDTH + GFX_CHAR_ADVANCE - GFX_CHAR_WIDTH) / GFX_CHAR_ADVANCE)
+#define TERM_ROWS (SSD1306_HEIGHT / GFX_CHAR_HEIGHT)
+
+#ifndef TERM_RENDER_INTERVAL
+#define TERM_RENDER_INTERVAL 50		//< Max ms between renders of a continuous stream
+#endif
+
+void TERM_init(void);
+void TERM_feed(const uint8_t *data, uint16_t len);
+void TERM_render(void);
+#ifdef USE_HAL_DRIVER
+void TERM_process(void);
+#endif
+
+#endif /* INC_TERM_H_ */
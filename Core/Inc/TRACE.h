@@ -0,0 +1,94 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * Driver event trace. A fixed size ring keeps the last TRACE_SIZE events,
+ * each stamped with the DWT cycle counter and the exception number it was
+ * recorded from (0 for thread mode). Recording is lock free, so TRACE()
+ * may be used from thread and interrupt context alike, and costs a few
+ * tens of cycles so it can stay enabled in production builds.
+ *
+ * TRACE_dump() prints the ring over USART2, decode it on the host with
+ * Tools/trace_decode.py. The cycle counter wraps every 2^32 cycles, the
+ * decoder unwraps it assuming consecutive events are closer than that.
+ *
+ * Build with TRACE_ENABLE 0 to compile every trace point out. Host builds
+ * (without USE_HAL_DRIVER) have no cycle counter and always do.
+ */
+#ifndef INC_TRACE_H_
+#define INC_TRACE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE 1
+#endif
+#ifndef USE_HAL_DRIVER
+#undef TRACE_ENABLE
+#define TRACE_ENABLE 0
+#endif
+
+#ifndef TRACE_SIZE
+#define TRACE_SIZE 256	//< Events kept, must be a power of two
+#endif
+
+/* Event codes, Tools/trace_decode.py reads the names from here */
+typedef enum
+{
+	TRACE_NONE,
+	TRACE_MARK,				//< arg: user value
+	TRACE_REPAINT,			//< arg: page, 0xFFFF for a full frame
+	TRACE_DMA_START,		//< arg: bytes
+	TRACE_DMA_DONE,
+	TRACE_I2C_ERROR,		//< arg: HAL I2C error code
+	TRACE_BUS_WAIT,			//< Write had to wait for a previous transfer
+	TRACE_COMMAND,			//< arg: command byte
+	TRACE_START_LINE,		//< arg: display start line
+	TRACE_SCROLL,			//< arg: scroll command
+	TRACE_FRAME_DROP,		//< arg: remote frame type
+	TRACE_RX_DROP,			//< arg: serial bytes dropped so far
+	TRACE_REPAINT_SKIP,		//< arg: unchanged pages not sent, bit per page
+	TRACE_EVENTS
+} TRACE_event_id_t;
+
+typedef struct
+{
+	uint32_t time;			//< DWT cycle count
+	uint8_t event;			//< TRACE_event_id_t
+	uint8_t context;		//< Exception number, 0 in thread mode
+	uint16_t arg;
+} TRACE_event_t;
+
+#if TRACE_ENABLE
+#define TRACE(event, arg) TRACE_record((event), (arg))
+#else
+#define TRACE(event, arg)
+#endif
+
+void TRACE_record(TRACE_event_id_t event, uint16_t arg);
+void TRACE_clear(void);
+void TRACE_freeze(bool freeze);
+uint16_t TRACE_read(TRACE_event_t *out, uint16_t max);
+void TRACE_dump(void);
+
+#endif /* INC_TRACE_H_ */
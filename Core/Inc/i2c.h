@@ -27,19 +27,23 @@
 #include "main.h"
 
 /* USER CODE BEGIN Includes */
-
+#include "I2CBUS.h"
 /* USER CODE END Includes */
 
 extern I2C_HandleTypeDef hi2c1;
 
 /* USER CODE BEGIN Private defines */
-
+#if I2CBUS_I2C2
+extern I2C_HandleTypeDef hi2c2;
+#endif
 /* USER CODE END Private defines */
 
 void MX_I2C1_Init(void);
 
 /* USER CODE BEGIN Prototypes */
-
+#if I2CBUS_I2C2
+void MX_I2C2_Init(void);
+#endif
 /* USER CODE END Prototypes */
 
 #ifdef __cplusplus
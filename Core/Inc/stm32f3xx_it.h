@@ -59,6 +59,12 @@ void SysTick_Handler(void);
 void DMA1_Channel6_IRQHandler(void);
 void I2C1_EV_IRQHandler(void);
 /* USER CODE BEGIN EFP */
+void USART2_IRQHandler(void);
+void DMA1_Channel7_IRQHandler(void);
+void EXTI15_10_IRQHandler(void);
+void DMA1_Channel4_IRQHandler(void);
+void I2C2_EV_IRQHandler(void);
+void DMA2_Channel1_IRQHandler(void);
 
 /* USER CODE END EFP */
 
@@ -0,0 +1,134 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "CONSOLE.h"
+
+static uint8_t start_page;	// Display RAM page at the start of the COM scan
+static uint8_t line_page;	// Page holding the line being written
+static uint8_t column;		// Next character column on that line
+
+/*
+ * Logical y of a display RAM page. With 180 degree rotation done in
+ * software the logical frame is upside down in display RAM, so the newest
+ * line sits at the start of the scan instead of the end.
+ */
+static int16_t CONSOLE_page_y(uint8_t page)
+{
+	if (SSD1306_get_buffer_rotation() == 2)
+	{
+		page = CONSOLE_LINES - 1 - page;
+	}
+	return page * GFX_CHAR_HEIGHT;
+}
+
+/*!
+    @brief  Clear the display and reset the console to an empty screen.
+    @return None (void).
+    @note   The console owns the whole display while in use. Only rotations
+            0 and 2 are supported, as lines must run along display pages.
+*/
+void CONSOLE_init(void)
+{
+	start_page = 0;
+	column = 0;
+	line_page = (SSD1306_get_buffer_rotation() == 2) ? 0 : CONSOLE_LINES - 1;
+
+	SSD1306_display_clear();
+	SSD1306_set_start_line(0);
+	SSD1306_display_repaint();
+}
+
+/*!
+    @brief  Scroll the console up by one line and continue on a blank line.
+    @return None (void).
+    @note   The oldest line is overwritten in place and the display start
+            line moved, so this costs one page write and one command.
+*/
+void CONSOLE_new_line(void)
+{
+	if (SSD1306_get_buffer_rotation() == 2)
+	{
+		start_page = (start_page + CONSOLE_LINES - 1) % CONSOLE_LINES;
+		line_page = start_page;
+	}
+	else
+	{
+		line_page = start_page;
+		start_page = (start_page + 1) % CONSOLE_LINES;
+	}
+	column = 0;
+
+	memset(&SSD1306_get_buffer()[line_page * SSD1306_WIDTH], 0, SSD1306_WIDTH);
+	SSD1306_display_repaint_page(line_page);
+	SSD1306_set_start_line(start_page * 8);
+}
+
+/*!
+    @brief  Append text to the console.
+    @param  s
+            Zero terminated text. '\n' starts a new line, '\r' returns to
+            the start of the current line, long lines wrap.
+    @return None (void).
+    @note   Only the page of the line being written is sent to the display.
+*/
+void CONSOLE_write(const char *s)
+{
+	bool dirty = false;
+
+	for (; *s; s++)
+	{
+		if (*s == '\n')
+		{
+			if (dirty)
+			{
+				SSD1306_display_repaint_page(line_page);
+				dirty = false;
+			}
+			CONSOLE_new_line();
+		}
+		else if (*s == '\r')
+		{
+			column = 0;
+		}
+		else
+		{
+			if (column >= CONSOLE_COLUMNS)
+			{
+				if (dirty)
+				{
+					SSD1306_display_repaint_page(line_page);
+					dirty = false;
+				}
+				CONSOLE_new_line();
+			}
+			GFX_draw_char(column * GFX_CHAR_ADVANCE, CONSOLE_page_y(line_page), *s, SSD1306_WHITE, SSD1306_BLACK, 1, 1);
+			column++;
+			dirty = true;
+		}
+	}
+
+	if (dirty)
+	{
+		SSD1306_display_repaint_page(line_page);
+	}
+}
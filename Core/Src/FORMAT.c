@@ -0,0 +1,244 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include "FORMAT.h"
+
+/* Send a NUL terminated string through put */
+static void FORMAT_puts(FORMAT_put_t put, void *ctx, const char *s)
+{
+	while(*s)
+	{
+		put(*s++, ctx);
+	}
+}
+
+/*
+ * Format an unsigned number into the end of buf, most significant digit
+ * first, returning the first digit. buf must hold at least 11 bytes.
+ */
+static char * FORMAT_number(char *buf, uint32_t value, uint8_t base, bool upper)
+{
+	const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+	char *p = buf + 11;
+
+	*--p = '\0';
+	do
+	{
+		*--p = digits[value % base];
+		value /= base;
+	} while(value);
+	return p;
+}
+
+/* Pad a formatted number to width, with sign and zero/space/left padding */
+static void FORMAT_padded(FORMAT_put_t put, void *ctx, const char *digits, bool neg, uint8_t width, char pad, bool left)
+{
+	uint8_t len = strlen(digits) + (neg ? 1 : 0);
+
+	if(neg && pad == '0')
+	{
+		put('-', ctx);
+	}
+	while(!left && len < width)
+	{
+		put(pad, ctx);
+		width--;
+	}
+	if(neg && pad != '0')
+	{
+		put('-', ctx);
+	}
+	FORMAT_puts(put, ctx, digits);
+	while(left && len < width)
+	{
+		put(' ', ctx);
+		width--;
+	}
+}
+
+/**************************************************************************/
+/*!
+   @brief    Format a signed decimal number
+    @param    put     Output function
+    @param    ctx     Passed through to put
+    @param    value   Number to format
+    @param    width   Minimum field width, padded on the left with spaces
+*/
+/**************************************************************************/
+void FORMAT_int(FORMAT_put_t put, void *ctx, int32_t value, uint8_t width)
+{
+	char buf[11];
+	uint32_t abs = (value < 0) ? -(uint32_t)value : (uint32_t)value;
+
+	FORMAT_padded(put, ctx, FORMAT_number(buf, abs, 10, false), value < 0, width, ' ', false);
+}
+
+/**************************************************************************/
+/*!
+   @brief    Format an unsigned hexadecimal number
+    @param    put     Output function
+    @param    ctx     Passed through to put
+    @param    value   Number to format
+    @param    digits  Minimum number of digits, padded with zeros
+*/
+/**************************************************************************/
+void FORMAT_hex(FORMAT_put_t put, void *ctx, uint32_t value, uint8_t digits)
+{
+	char buf[11];
+
+	FORMAT_padded(put, ctx, FORMAT_number(buf, value, 16, true), false, digits, '0', false);
+}
+
+/**************************************************************************/
+/*!
+   @brief    Format a fixed-point decimal number
+    @param    put     Output function
+    @param    ctx     Passed through to put
+    @param    value   Number scaled by 10^decimals, e.g. 1234 with 2
+                      decimals gives "12.34"
+    @param    decimals  Digits after the decimal point, at most 9
+*/
+/**************************************************************************/
+void FORMAT_fixed(FORMAT_put_t put, void *ctx, int32_t value, uint8_t decimals)
+{
+	char buf[11], *p;
+	uint32_t abs = (value < 0) ? -(uint32_t)value : (uint32_t)value;
+	uint32_t scale = 1;
+	uint8_t i;
+
+	for(i = 0; i < decimals && i < 9; i++)
+	{
+		scale *= 10;
+	}
+
+	if(value < 0)
+	{
+		put('-', ctx);
+	}
+	FORMAT_puts(put, ctx, FORMAT_number(buf, abs / scale, 10, false));
+	if(i)
+	{
+		put('.', ctx);
+		p = FORMAT_number(buf, abs % scale, 10, false);
+		for(decimals = strlen(p); decimals < i; decimals++)
+		{
+			put('0', ctx);
+		}
+		FORMAT_puts(put, ctx, p);
+	}
+}
+
+/**************************************************************************/
+/*!
+   @brief    Formatted output without heap or stdio
+    @param    put   Output function, called once per character
+    @param    ctx   Passed through to put
+    @param    fmt   Format string supporting %d %i %u %x %X %c %s %% with
+                    optional '-' and '0' flags, field width and 'l'
+    @param    args  Arguments for fmt
+*/
+/**************************************************************************/
+void FORMAT_vprint(FORMAT_put_t put, void *ctx, const char *fmt, va_list args)
+{
+	char buf[11], pad;
+	const char *str;
+	uint8_t width;
+	bool left, is_long;
+	int32_t value;
+	uint32_t uvalue;
+
+	for(; *fmt; fmt++)
+	{
+		if(*fmt != '%')
+		{
+			put(*fmt, ctx);
+			continue;
+		}
+
+		left = false;
+		pad = ' ';
+		width = 0;
+		for(fmt++; *fmt == '-' || *fmt == '0'; fmt++)
+		{
+			if(*fmt == '-')
+			{
+				left = true;
+			}
+			else
+			{
+				pad = '0';
+			}
+		}
+		while(*fmt >= '0' && *fmt <= '9')
+		{
+			width = width * 10 + (*fmt++ - '0');
+		}
+		is_long = (*fmt == 'l');
+		if(is_long)
+		{
+			fmt++;
+		}
+		if(left)
+		{
+			pad = ' ';
+		}
+
+		switch(*fmt)
+		{
+			case 'd':
+			case 'i':
+				value = is_long ? va_arg(args, long) : va_arg(args, int);
+				str = FORMAT_number(buf, (value < 0) ? -(uint32_t)value : (uint32_t)value, 10, false);
+				FORMAT_padded(put, ctx, str, value < 0, width, pad, left);
+				break;
+			case 'u':
+			case 'x':
+			case 'X':
+				uvalue = is_long ? va_arg(args, unsigned long) : va_arg(args, unsigned int);
+				str = FORMAT_number(buf, uvalue, (*fmt == 'u') ? 10 : 16, *fmt == 'X');
+				FORMAT_padded(put, ctx, str, false, width, pad, left);
+				break;
+			case 'c':
+				buf[0] = (char)va_arg(args, int);
+				buf[1] = '\0';
+				FORMAT_padded(put, ctx, buf, false, width, ' ', left);
+				break;
+			case 's':
+				str = va_arg(args, const char *);
+				FORMAT_padded(put, ctx, str ? str : "(null)", false, width, ' ', left);
+				break;
+			case '%':
+				put('%', ctx);
+				break;
+			case '\0':
+				fmt--;
+				break;
+			default:
+				put('%', ctx);
+				put(*fmt, ctx);
+				break;
+		}
+	}
+}
+
@@ -54,8 +54,186 @@ POSSIBILITY OF SUCH DAMAGE.
  */
 
 #include "GFX.h"
+#include "FORMAT.h"
+#include "PROF.h"
 #include "font_ascii_5x7.h"
 
+/* Text cursor used by GFX_write() and the print functions */
+static int16_t cursor_x, cursor_y;
+static uint16_t text_color = SSD1306_WHITE, text_bg = SSD1306_WHITE;
+static uint8_t text_size_x = 1, text_size_y = 1;
+static bool text_wrap = true;
+
+/* Cleared to draw everything through the per-pixel reference paths */
+static bool fast_paths = true;
+
+static void GFX_draw_char_internal(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size_x, uint8_t size_y);
+
+/* Screen size as drawn, after rotation */
+static int16_t GFX_width(void)
+{
+	return (SSD1306_get_rotation() & 1) ? HEIGHT : WIDTH;
+}
+
+static int16_t GFX_height(void)
+{
+	return (SSD1306_get_rotation() & 1) ? WIDTH : HEIGHT;
+}
+
+#if GFX_GLYPH_CACHE_SIZE > 0
+typedef struct
+{
+	const unsigned char *font;
+	uint32_t stamp;		// LRU timestamp, 0 marks an empty slot
+	uint8_t glyph;
+	uint8_t size_y;
+	uint8_t shift;		// y & 7 the glyph was decoded for
+	uint8_t pages;
+	uint8_t mask[GFX_GLYPH_CACHE_PAGES];		// Character cell
+	uint8_t bits[6][GFX_GLYPH_CACHE_PAGES];	// Set pixels, column 5 is spacing
+} GFX_glyph_t;
+
+static GFX_glyph_t glyph_cache[GFX_GLYPH_CACHE_SIZE];
+static GFX_glyph_cache_stats_t glyph_stats;
+static uint32_t glyph_clock;
+
+static void GFX_glyph_decode(GFX_glyph_t *g)
+{
+	uint32_t col, rows = (1UL << g->size_y) - 1;
+	uint8_t i, j, p, line;
+
+	col = ((1UL << (8 * g->size_y)) - 1) << g->shift;
+	for(p = 0; p < GFX_GLYPH_CACHE_PAGES; p++)
+	{
+		g->mask[p] = col >> (8 * p);
+		g->bits[5][p] = 0;
+	}
+
+	for(i = 0; i < 5; i++)
+	{
+		// Font bit 0 is drawn on the bottom row of the cell
+		line = (*(const unsigned char *)(&g->font[g->glyph * 5 + i]));
+		for(j = 0, col = 0; j < 8; j++, line >>= 1)
+		{
+			if(line & 1)
+			{
+				col |= rows << ((7 - j) * g->size_y);
+			}
+		}
+		col <<= g->shift;
+		for(p = 0; p < GFX_GLYPH_CACHE_PAGES; p++)
+		{
+			g->bits[i][p] = col >> (8 * p);
+		}
+	}
+	g->pages = (g->shift + 8 * g->size_y + 7) / 8;
+}
+
+static const GFX_glyph_t * GFX_glyph_lookup(const unsigned char *f, unsigned char c, uint8_t size_y, uint8_t shift)
+{
+	GFX_glyph_t *g, *victim = &glyph_cache[0];
+
+	if(++glyph_clock == 0)
+	{
+		// Timestamps wrapped, start over
+		GFX_glyph_cache_flush();
+		glyph_clock = 1;
+	}
+
+	for(g = glyph_cache; g < &glyph_cache[GFX_GLYPH_CACHE_SIZE]; g++)
+	{
+		if(g->stamp && g->font == f && g->glyph == c && g->size_y == size_y && g->shift == shift)
+		{
+			g->stamp = glyph_clock;
+			glyph_stats.hits++;
+			return g;
+		}
+		if(g->stamp < victim->stamp)
+		{
+			victim = g;
+		}
+	}
+
+	glyph_stats.misses++;
+	if(victim->stamp)
+	{
+		glyph_stats.evictions++;
+	}
+	victim->font = f;
+	victim->glyph = c;
+	victim->size_y = size_y;
+	victim->shift = shift;
+	victim->stamp = glyph_clock;
+	GFX_glyph_decode(victim);
+	return victim;
+}
+
+static inline void GFX_glyph_apply(uint8_t *pBuf, uint8_t bits, uint16_t color)
+{
+	switch(color)
+	{
+		case SSD1306_WHITE:
+			*pBuf |= bits;
+			break;
+		case SSD1306_BLACK:
+			*pBuf &= ~bits;
+			break;
+		case SSD1306_INVERSE:
+			*pBuf ^= bits;
+			break;
+	}
+}
+
+static void GFX_glyph_blit(int16_t x, int16_t y, const GFX_glyph_t *g, uint16_t color, uint16_t bg, uint8_t size_x)
+{
+	uint8_t *pBuf, *buffer = SSD1306_get_buffer();
+	uint8_t i, sx, p, first = 0, pages = g->pages;
+	uint8_t cols = (bg != color) ? 6 : 5;
+	int16_t col, top, bottom, width = SSD1306_get_buffer_width();
+
+	// Clip the glyph pages to the rows held by the buffer
+	SSD1306_get_band(&top, &bottom);
+	if((y / 8) + pages > bottom / 8)
+	{
+		pages = (bottom / 8 > y / 8) ? bottom / 8 - (y / 8) : 0;
+	}
+	if(y / 8 < top / 8)
+	{
+		first = top / 8 - y / 8;
+	}
+	if(first >= pages)
+	{
+		return;
+	}
+
+	for(i = 0; i < cols; i++)
+	{
+		for(sx = 0; sx < size_x; sx++)
+		{
+			col = x + i * size_x + sx;
+			if(col < 0)
+			{
+				continue;
+			}
+			if(col >= width)
+			{
+				return;
+			}
+
+			pBuf = &buffer[((y / 8) + first - (top / 8)) * width + col];
+			for(p = first; p < pages; p++, pBuf += width)
+			{
+				GFX_glyph_apply(pBuf, g->bits[i][p], color);
+				if(bg != color)
+				{
+					GFX_glyph_apply(pBuf, g->mask[p] & ~g->bits[i][p], bg);
+				}
+			}
+		}
+	}
+}
+#endif
+
 /**************************************************************************/
 /*!
    @brief   Draw a single character
@@ -69,14 +247,31 @@ POSSIBILITY OF SUCH DAMAGE.
 */
 /**************************************************************************/
 void GFX_draw_char(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size_x, uint8_t size_y)
+{
+	PROF_BEGIN(PROF_DRAW_CHAR);
+	GFX_draw_char_internal(x, y, c, color, bg, size_x, size_y);
+	PROF_END(PROF_DRAW_CHAR);
+}
+
+/* Body of GFX_draw_char(), kept apart so the profiling probe sees every return */
+static void GFX_draw_char_internal(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size_x, uint8_t size_y)
 {
 	int8_t i, j;
 	uint8_t line;
 
-	if((x >= WIDTH) || (y >= HEIGHT) || ((x + 6 * size_x - 1) < 0) || ((y + 8 * size_y - 1) < 0))
+	if((x >= GFX_width()) || (y >= GFX_height()) || ((x + 6 * size_x - 1) < 0) || ((y + 8 * size_y - 1) < 0))
+	{
+		return;
+	}
+
+#if GFX_GLYPH_CACHE_SIZE > 0
+	// Unrotated glyphs are drawn straight from the cache, page column at a time
+	if(fast_paths && (SSD1306_get_buffer_rotation() == 0) && (y >= 0) && (size_y * 8 + 7 <= GFX_GLYPH_CACHE_PAGES * 8))
 	{
+		GFX_glyph_blit(x, y, GFX_glyph_lookup(font, c, size_y, y & 7), color, bg, size_x);
 		return;
 	}
+#endif
 
 	for(i = 0; i < 5; i++)  // Char bitmap = 5 columns
 	{
@@ -135,13 +330,14 @@ void GFX_draw_char(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16
 /**************************************************************************/
 void GFX_draw_string(int16_t x, int16_t y, unsigned char * c, uint16_t color, uint16_t bg, uint8_t size_x, uint8_t size_y)
 {
-	uint8_t offset = 0;
+	PROF_BEGIN(PROF_DRAW_STRING);
 	while(*c)
 	{
-		GFX_draw_char(x+offset, y, *c, color, bg, size_x, size_y);
-		offset += (5 + 2) * size_x;
+		GFX_draw_char(x, y, *c, color, bg, size_x, size_y);
+		x += GFX_CHAR_ADVANCE * size_x;
 		c++;
 	}
+	PROF_END(PROF_DRAW_STRING);
 }
 
 /**************************************************************************/
@@ -156,8 +352,441 @@ void GFX_draw_string(int16_t x, int16_t y, unsigned char * c, uint16_t color, ui
 /**************************************************************************/
 void GFX_draw_fill_rect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
 {
+	PROF_BEGIN(PROF_FILL_RECT);
 	for(int16_t i = x; i < x + w; i++)
 	{
 		SSD1306_draw_fast_vline(i, y, h, color);
 	}
+	PROF_END(PROF_FILL_RECT);
+}
+
+/**************************************************************************/
+/*!
+   @brief    Measure a run of characters without drawing it
+    @param    c   The 8-bit font-indexed characters
+    @param    len Number of characters to measure
+    @param    size_x  Font magnification level in X-axis
+    @return   Width in pixels from the first to the last lit column
+*/
+/**************************************************************************/
+int16_t GFX_get_text_width(const unsigned char *c, uint16_t len, uint8_t size_x)
+{
+	(void)c;
+	if(len == 0)
+	{
+		return 0;
+	}
+	return (int16_t)(len * GFX_CHAR_ADVANCE - (GFX_CHAR_ADVANCE - GFX_CHAR_WIDTH)) * size_x;
+}
+
+/**************************************************************************/
+/*!
+   @brief    Measure a string, honouring embedded newlines
+    @param    c   The 8-bit font-indexed characters (likely ascii)
+    @param    size_x  Font magnification level in X-axis
+    @param    size_y  Font magnification level in Y-axis
+    @param    w   Width of the widest line in pixels
+    @param    h   Height of all lines in pixels
+*/
+/**************************************************************************/
+void GFX_get_text_bounds(const unsigned char *c, uint8_t size_x, uint8_t size_y, int16_t *w, int16_t *h)
+{
+	uint16_t len = 0, lines = 1;
+	int16_t line_w;
+
+	*w = 0;
+	for(;; c++)
+	{
+		if(*c == '\n' || *c == '\0')
+		{
+			line_w = GFX_get_text_width(c - len, len, size_x);
+			if(line_w > *w)
+			{
+				*w = line_w;
+			}
+			if(*c == '\0')
+			{
+				break;
+			}
+			len = 0;
+			lines++;
+		}
+		else
+		{
+			len++;
+		}
+	}
+	*h = lines * GFX_CHAR_HEIGHT * size_y;
+}
+
+/**************************************************************************/
+/*!
+   @brief    Break a string into lines fitting a box, without drawing it
+    @param    c   The 8-bit font-indexed characters (likely ascii)
+    @param    w   Box width in pixels
+    @param    h   Box height in pixels
+    @param    size_x  Font magnification level in X-axis
+    @param    size_y  Font magnification level in Y-axis
+    @param    flags   GFX_ALIGN_x, optionally or-ed with GFX_TEXT_WRAP and
+                      GFX_TEXT_ELLIPSIS
+    @param    lines   Receives one entry per laid out line
+    @param    max_lines   Size of the lines array
+    @return   Number of lines stored
+    @note     Lines are broken at spaces where possible and at '\n'. Text
+              that does not fit is dropped, or replaced by "..." at the end
+              of the last line with GFX_TEXT_ELLIPSIS.
+*/
+/**************************************************************************/
+uint8_t GFX_layout_text(const unsigned char *c, int16_t w, int16_t h, uint8_t size_x, uint8_t size_y, uint8_t flags, GFX_text_line_t *lines, uint8_t max_lines)
+{
+	int16_t fit = (w + (GFX_CHAR_ADVANCE - GFX_CHAR_WIDTH) * size_x) / (GFX_CHAR_ADVANCE * size_x);
+	int16_t rows = h / (GFX_CHAR_HEIGHT * size_y), line_w;
+	uint16_t pos = 0, len, brk;
+	uint8_t n = 0;
+	GFX_text_line_t *line;
+
+	if(rows > max_lines)
+	{
+		rows = max_lines;
+	}
+	if(fit <= 0 || rows <= 0)
+	{
+		return 0;
+	}
+
+	while(c[pos] && n < rows)
+	{
+		line = &lines[n++];
+		line->start = pos;
+		line->ellipsis = false;
+
+		// Longest run up to a newline, or up to the box edge when wrapping
+		for(len = 0, brk = 0; c[pos + len] && c[pos + len] != '\n'; len++)
+		{
+			if(c[pos + len] == ' ')
+			{
+				brk = len;
+			}
+			if((flags & GFX_TEXT_WRAP) && len == fit)
+			{
+				// Prefer breaking at the last space, else split the word
+				if(c[pos + len] != ' ' && brk)
+				{
+					len = brk;
+				}
+				break;
+			}
+		}
+		line->len = len;
+		pos += len;
+
+		if(flags & GFX_TEXT_WRAP)
+		{
+			while(c[pos] == ' ')
+			{
+				pos++;
+			}
+		}
+		else
+		{
+			while(c[pos] && c[pos] != '\n')
+			{
+				pos++;
+			}
+		}
+		if(c[pos] == '\n')
+		{
+			pos++;
+		}
+
+		if(line->len > fit)
+		{
+			line->len = fit;
+			line->ellipsis = true;
+		}
+		else if(n == rows && c[pos])
+		{
+			line->ellipsis = true;
+		}
+		if(line->ellipsis)
+		{
+			if(flags & GFX_TEXT_ELLIPSIS)
+			{
+				line->len = (line->len + 3 <= fit) ? line->len : ((fit > 3) ? fit - 3 : 0);
+				while(line->len && c[line->start + line->len - 1] == ' ')
+				{
+					line->len--;
+				}
+			}
+			else
+			{
+				line->ellipsis = false;
+			}
+		}
+
+		line_w = GFX_get_text_width(&c[line->start], line->len + (line->ellipsis ? 3 : 0), size_x);
+		switch(flags & GFX_ALIGN_MASK)
+		{
+			case GFX_ALIGN_CENTER:
+				line->x = (w - line_w) / 2;
+				break;
+			case GFX_ALIGN_RIGHT:
+				line->x = w - line_w;
+				break;
+			default:
+				line->x = 0;
+				break;
+		}
+	}
+	return n;
+}
+
+/**************************************************************************/
+/*!
+   @brief    Lay out and draw a string inside a box
+    @param    x   Top left corner x coordinate
+    @param    y   Top left corner y coordinate
+    @param    w   Box width in pixels
+    @param    h   Box height in pixels
+    @param    c   The 8-bit font-indexed characters (likely ascii)
+    @param    color Color to draw characters with
+    @param    bg Color to fill background with (if same as color, no background)
+    @param    size_x  Font magnification level in X-axis
+    @param    size_y  Font magnification level in Y-axis
+    @param    flags   Layout flags, see GFX_layout_text()
+    @return   Number of lines drawn
+*/
+/**************************************************************************/
+uint8_t GFX_draw_text_box(int16_t x, int16_t y, int16_t w, int16_t h, const unsigned char *c, uint16_t color, uint16_t bg, uint8_t size_x, uint8_t size_y, uint8_t flags)
+{
+	GFX_text_line_t lines[HEIGHT / GFX_CHAR_HEIGHT];
+	uint8_t i, n;
+	int16_t cx;
+	uint16_t j;
+
+	PROF_BEGIN(PROF_DRAW_TEXT_BOX);
+	n = GFX_layout_text(c, w, h, size_x, size_y, flags, lines, HEIGHT / GFX_CHAR_HEIGHT);
+	for(i = 0; i < n; i++, y += GFX_CHAR_HEIGHT * size_y)
+	{
+		cx = x + lines[i].x;
+		for(j = 0; j < lines[i].len; j++, cx += GFX_CHAR_ADVANCE * size_x)
+		{
+			GFX_draw_char(cx, y, c[lines[i].start + j], color, bg, size_x, size_y);
+		}
+		for(j = 0; lines[i].ellipsis && j < 3; j++, cx += GFX_CHAR_ADVANCE * size_x)
+		{
+			GFX_draw_char(cx, y, '.', color, bg, size_x, size_y);
+		}
+	}
+	PROF_END(PROF_DRAW_TEXT_BOX);
+	return n;
+}
+
+/**************************************************************************/
+/*!
+   @brief    Set text cursor location
+    @param    x   X coordinate in pixels
+    @param    y   Y coordinate in pixels
+*/
+/**************************************************************************/
+void GFX_set_cursor(int16_t x, int16_t y)
+{
+	cursor_x = x;
+	cursor_y = y;
+}
+
+/**************************************************************************/
+/*!
+   @brief    Get text cursor location
+    @param    x   Current X coordinate in pixels
+    @param    y   Current Y coordinate in pixels
+*/
+/**************************************************************************/
+void GFX_get_cursor(int16_t *x, int16_t *y)
+{
+	*x = cursor_x;
+	*y = cursor_y;
+}
+
+/**************************************************************************/
+/*!
+   @brief    Set text colors for the cursor based print functions
+    @param    color Color to draw characters with
+    @param    bg Color to fill background with (if same as color, no background)
+*/
+/**************************************************************************/
+void GFX_set_text_color(uint16_t color, uint16_t bg)
+{
+	text_color = color;
+	text_bg = bg;
+}
+
+/**************************************************************************/
+/*!
+   @brief    Set text magnification for the cursor based print functions
+    @param    size_x  Font magnification level in X-axis, 1 is 'original' size
+    @param    size_y  Font magnification level in Y-axis, 1 is 'original' size
+*/
+/**************************************************************************/
+void GFX_set_text_size(uint8_t size_x, uint8_t size_y)
+{
+	text_size_x = (size_x > 0) ? size_x : 1;
+	text_size_y = (size_y > 0) ? size_y : 1;
+}
+
+/**************************************************************************/
+/*!
+   @brief    Enable or disable wrapping to the next line at the right edge
+    @param    wrap   true to wrap, false to clip
+*/
+/**************************************************************************/
+void GFX_set_text_wrap(bool wrap)
+{
+	text_wrap = wrap;
+}
+
+/**************************************************************************/
+/*!
+   @brief    Draw one character at the cursor and advance it
+    @param    c   The 8-bit font-indexed character, '\n' starts a new line
+                  and '\r' returns to the left edge
+*/
+/**************************************************************************/
+void GFX_write(unsigned char c)
+{
+	if(c == '\n')
+	{
+		cursor_x = 0;
+		cursor_y += GFX_CHAR_HEIGHT * text_size_y;
+	}
+	else if(c == '\r')
+	{
+		cursor_x = 0;
+	}
+	else
+	{
+		if(text_wrap && (cursor_x + GFX_CHAR_WIDTH * text_size_x > GFX_width()))
+		{
+			cursor_x = 0;
+			cursor_y += GFX_CHAR_HEIGHT * text_size_y;
+		}
+		GFX_draw_char(cursor_x, cursor_y, c, text_color, text_bg, text_size_x, text_size_y);
+		cursor_x += GFX_CHAR_ADVANCE * text_size_x;
+	}
+}
+
+/**************************************************************************/
+/*!
+   @brief    Draw a string at the cursor
+    @param    s   Zero terminated string
+*/
+/**************************************************************************/
+void GFX_print(const char *s)
+{
+	while(*s)
+	{
+		GFX_write(*s++);
+	}
+}
+
+/* Output function for the formatter */
+static void GFX_put(char c, void *ctx)
+{
+	(void)ctx;
+	GFX_write(c);
+}
+
+/**************************************************************************/
+/*!
+   @brief    Draw a signed decimal number at the cursor
+    @param    value   Number to draw
+    @param    width   Minimum field width, padded on the left with spaces
+*/
+/**************************************************************************/
+void GFX_print_int(int32_t value, uint8_t width)
+{
+	FORMAT_int(GFX_put, NULL, value, width);
+}
+
+/**************************************************************************/
+/*!
+   @brief    Draw an unsigned hexadecimal number at the cursor
+    @param    value   Number to draw
+    @param    digits  Minimum number of digits, padded with zeros
+*/
+/**************************************************************************/
+void GFX_print_hex(uint32_t value, uint8_t digits)
+{
+	FORMAT_hex(GFX_put, NULL, value, digits);
+}
+
+/**************************************************************************/
+/*!
+   @brief    Draw a fixed-point decimal number at the cursor
+    @param    value   Number scaled by 10^decimals, e.g. 1234 with 2
+                      decimals draws "12.34"
+    @param    decimals  Digits after the decimal point, at most 9
+*/
+/**************************************************************************/
+void GFX_print_fixed(int32_t value, uint8_t decimals)
+{
+	FORMAT_fixed(GFX_put, NULL, value, decimals);
+}
+
+/**************************************************************************/
+/*!
+   @brief    Formatted print at the cursor without heap or stdio
+    @param    fmt   Format string, see FORMAT_vprint()
+    @note     Each glyph is drawn as soon as it is formatted, there is no
+              intermediate string buffer.
+*/
+/**************************************************************************/
+void GFX_printf(const char *fmt, ...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	FORMAT_vprint(GFX_put, NULL, fmt, args);
+	va_end(args);
+}
+
+/**************************************************************************/
+/*!
+   @brief    Enable or disable optimised drawing paths
+    @param    enable  false draws through SSD1306_draw_pixel() and the line
+                      primitives only, the reference the optimised paths
+                      must match pixel for pixel
+*/
+/**************************************************************************/
+void GFX_set_fast_paths(bool enable)
+{
+	fast_paths = enable;
+}
+
+/**************************************************************************/
+/*!
+   @brief    Drop all glyphs from the glyph cache, e.g. after a font in RAM
+             was modified
+*/
+/**************************************************************************/
+void GFX_glyph_cache_flush(void)
+{
+#if GFX_GLYPH_CACHE_SIZE > 0
+	memset(glyph_cache, 0, sizeof(glyph_cache));
+#endif
+}
+
+/**************************************************************************/
+/*!
+   @brief    Read glyph cache hit/miss counters
+    @param    stats   Filled with the counters collected since startup
+*/
+/**************************************************************************/
+void GFX_glyph_cache_get_stats(GFX_glyph_cache_stats_t *stats)
+{
+#if GFX_GLYPH_CACHE_SIZE > 0
+	*stats = glyph_stats;
+#else
+	memset(stats, 0, sizeof(*stats));
+#endif
 }
@@ -0,0 +1,498 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include "I2CBUS.h"
+#include "PROF.h"
+#include "SCHED.h"
+#include "TRACE.h"
+#include "i2c.h"
+
+typedef struct
+{
+	I2C_HandleTypeDef *hi2c;
+	I2CBUS_xfer_t *head[I2CBUS_PRIO_COUNT], *tail[I2CBUS_PRIO_COUNT];
+	I2CBUS_xfer_t *active;	// Transaction owning the bus
+	I2CBUS_xfer_t *done_head, *done_tail;	// Finished, done not called yet
+	uint16_t active_len;	// Bytes in the chunk on the bus
+	uint32_t chunk_start;	// Cycle count at the chunk start
+	I2CBUS_stats_t stats;
+#if I2CBUS_LL
+	volatile bool ll_active;	// Register level write on the bus
+	bool ll_nack;
+	uint8_t ll_reg;
+	uint16_t ll_left;		// Bytes not yet counted into NBYTES
+#endif
+} I2CBUS_bus_t;
+
+static I2CBUS_bus_t buses[I2CBUS_BUSES] =
+{
+	{ .hi2c = &hi2c1 },
+#if I2CBUS_I2C2
+	{ .hi2c = &hi2c2 },
+#endif
+};
+
+static void I2CBUS_chunk_done(I2CBUS_bus_t *b, bool ok);
+
+#if I2CBUS_LL
+/*
+ * Start a write on the registers. The register byte is written from the
+ * TXIS interrupt, then DMA feeds TXDR. Transfers over 255 bytes reload
+ * NBYTES from the TCR interrupt, STOPF ends the transfer.
+ */
+static HAL_StatusTypeDef I2CBUS_ll_write(I2CBUS_bus_t *b, uint16_t addr, uint8_t reg, uint8_t *data, uint16_t len)
+{
+	I2C_TypeDef *i2c = b->hi2c->Instance;
+	DMA_HandleTypeDef *dma = b->hi2c->hdmatx;
+	uint16_t n;
+
+	if ((HAL_I2C_GetState(b->hi2c) != HAL_I2C_STATE_READY) || (i2c->ISR & I2C_ISR_BUSY))
+	{
+		return HAL_BUSY;
+	}
+
+	// Direction, increment and priority stay as set up by the MSP init
+	dma->Instance->CCR &= ~(DMA_CCR_EN | DMA_CCR_TCIE | DMA_CCR_HTIE | DMA_CCR_TEIE);
+	dma->DmaBaseAddress->IFCR = DMA_FLAG_GL1 << dma->ChannelIndex;
+	dma->Instance->CPAR = (uint32_t)&i2c->TXDR;
+	dma->Instance->CMAR = (uint32_t)data;
+	dma->Instance->CNDTR = len;
+	dma->Instance->CCR |= DMA_CCR_EN;
+
+	b->ll_active = true;
+	b->ll_nack = false;
+	b->ll_reg = reg;
+	b->ll_left = len + 1;
+	n = (b->ll_left > 255) ? 255 : b->ll_left;
+	b->ll_left -= n;
+
+	i2c->ICR = I2C_ICR_STOPCF | I2C_ICR_NACKCF;
+	i2c->CR1 |= I2C_CR1_TXIE | I2C_CR1_TCIE | I2C_CR1_STOPIE | I2C_CR1_NACKIE;
+	i2c->CR2 = (addr & I2C_CR2_SADD) | ((uint32_t)n << I2C_CR2_NBYTES_Pos) |
+			(b->ll_left ? I2C_CR2_RELOAD : I2C_CR2_AUTOEND) | I2C_CR2_START;
+	return HAL_OK;
+}
+#endif
+
+/* Call the done callbacks of the finished transactions, from the main loop */
+static void I2CBUS_report(void *ctx)
+{
+	I2CBUS_bus_t *b = (I2CBUS_bus_t *)ctx;
+	I2CBUS_xfer_t *x;
+	uint32_t primask;
+	bool ok = false;
+
+	do
+	{
+		primask = __get_PRIMASK();
+		__disable_irq();
+		x = b->done_head;
+		if (x)
+		{
+			b->done_head = x->done_next;
+			if (!b->done_head)
+			{
+				b->done_tail = NULL;
+			}
+			x->reporting = false;
+			ok = x->ok;
+		}
+		__set_PRIMASK(primask);
+		if (x)
+		{
+			x->done(x, ok);
+		}
+	} while (x);
+}
+
+/*
+ * Take a finished transaction off its queue and have it reported. One
+ * posted call per bus drains the done list, so a burst of completions
+ * takes a single scheduler slot. Call with interrupts off.
+ */
+static void I2CBUS_finish(I2CBUS_bus_t *b, I2CBUS_xfer_t *x, bool ok)
+{
+	b->head[x->prio] = x->next;
+	if (!x->next)
+	{
+		b->tail[x->prio] = NULL;
+	}
+	b->stats.transfers++;
+	x->pending = false;
+	if (!x->done)
+	{
+		return;
+	}
+	if (x->reporting)
+	{
+		// Resubmitted and done again before its last report ran
+		x->ok = x->ok && ok;
+		return;
+	}
+	x->ok = ok;
+	x->reporting = true;
+	x->done_next = NULL;
+	if (b->done_tail)
+	{
+		b->done_tail->done_next = x;
+		b->done_tail = x;
+	}
+	else
+	{
+		b->done_head = b->done_tail = x;
+		SCHED_complete(I2CBUS_report, b);
+	}
+}
+
+/* Start the next chunk unless the bus is taken, call with interrupts off */
+static void I2CBUS_start(I2CBUS_bus_t *b)
+{
+	I2CBUS_xfer_t *x;
+	HAL_StatusTypeDef status;
+	uint32_t wait;
+	uint8_t p;
+
+	while (!b->active)
+	{
+		// A partly sent transaction stays at the head of its queue
+		for (p = 0, x = NULL; (p < I2CBUS_PRIO_COUNT) && !(x = b->head[p]); p++);
+		if (!x)
+		{
+			return;
+		}
+
+		b->active_len = x->len - x->offset;
+		if (x->chunk && (b->active_len > x->chunk))
+		{
+			b->active_len = x->chunk;
+		}
+		b->chunk_start = PROF_CYCLES();
+		if (x->offset == 0)
+		{
+			wait = b->chunk_start - x->queued;
+			if (wait > b->stats.max_wait[p])
+			{
+				b->stats.max_wait[p] = wait;
+			}
+		}
+
+		b->active = x;
+		TRACE(TRACE_DMA_START, b->active_len);
+		if (x->read)
+		{
+			status = HAL_I2C_Mem_Read_IT(b->hi2c, x->addr, x->reg, x->reg_size, &x->data[x->offset], b->active_len);
+		}
+#if I2CBUS_LL
+		else if (x->reg_size == 1)
+		{
+			status = I2CBUS_ll_write(b, x->addr, x->reg, &x->data[x->offset], b->active_len);
+		}
+#endif
+		else
+		{
+			status = HAL_I2C_Mem_Write_DMA(b->hi2c, x->addr, x->reg, x->reg_size, &x->data[x->offset], b->active_len);
+		}
+		if (status != HAL_OK)
+		{
+			// Fail it rather than stall the queue
+			TRACE(TRACE_I2C_ERROR, status);
+			b->stats.errors++;
+			b->active = NULL;
+			I2CBUS_finish(b, x, false);
+		}
+	}
+}
+
+/* The chunk on the bus is done, continue with whatever is most urgent */
+static void I2CBUS_chunk_done(I2CBUS_bus_t *b, bool ok)
+{
+	I2CBUS_xfer_t *x = b->active;
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	b->active = NULL;
+	if (x)
+	{
+		b->stats.chunks++;
+		x->offset += b->active_len;
+		if (!ok)
+		{
+			b->stats.errors++;
+			I2CBUS_finish(b, x, false);
+		}
+		else if (x->offset >= x->len)
+		{
+			I2CBUS_finish(b, x, true);
+		}
+	}
+	I2CBUS_start(b);
+	__set_PRIMASK(primask);
+}
+
+/* Bus of a HAL handle, NULL for handles not managed here */
+static I2CBUS_bus_t * I2CBUS_find(I2C_HandleTypeDef *hi2c)
+{
+	uint8_t i;
+
+	for (i = 0; i < I2CBUS_BUSES; i++)
+	{
+		if (buses[i].hi2c == hi2c)
+		{
+			return &buses[i];
+		}
+	}
+	return NULL;
+}
+
+/*!
+    @brief  Queue a transaction.
+    @param  xfer
+            Filled in by the caller and left untouched, data included,
+            until it is no longer pending.
+    @return false if xfer is still pending, has no data or names no bus.
+    @note   Safe from interrupts. The bus is started right away when
+            idle, otherwise xfer waits for the transactions before it.
+*/
+bool I2CBUS_submit(I2CBUS_xfer_t *xfer)
+{
+	I2CBUS_bus_t *b;
+	uint32_t primask = __get_PRIMASK();
+
+	if (xfer->pending || !xfer->len || (xfer->prio >= I2CBUS_PRIO_COUNT) || (xfer->bus >= I2CBUS_BUSES))
+	{
+		return false;
+	}
+	b = &buses[xfer->bus];
+
+	xfer->offset = 0;
+	xfer->next = NULL;
+	xfer->queued = PROF_CYCLES();
+	xfer->pending = true;
+
+	__disable_irq();
+	if (b->tail[xfer->prio])
+	{
+		b->tail[xfer->prio]->next = xfer;
+	}
+	else
+	{
+		b->head[xfer->prio] = xfer;
+	}
+	b->tail[xfer->prio] = xfer;
+	I2CBUS_start(b);
+	__set_PRIMASK(primask);
+	return true;
+}
+
+/*!
+    @brief  Check whether a transaction is queued or in progress.
+    @param  xfer
+            Transaction.
+    @return true until it has completed or failed.
+*/
+bool I2CBUS_pending(const I2CBUS_xfer_t *xfer)
+{
+	return xfer->pending;
+}
+
+/*!
+    @brief  Wait for a transaction to complete or fail.
+    @param  xfer
+            Transaction, returns at once if not pending.
+    @return None (void).
+    @note   Busy waits, not for use from interrupts of equal or higher
+            priority than the bus.
+*/
+void I2CBUS_wait(const I2CBUS_xfer_t *xfer)
+{
+	if (xfer->pending)
+	{
+		TRACE(TRACE_BUS_WAIT, 0);
+		while (xfer->pending);
+	}
+}
+
+/*!
+    @brief  Check for bus activity.
+    @param  bus
+            I2CBUS_bus_id_t.
+    @return true while a transaction is on the bus or queued.
+*/
+bool I2CBUS_busy(uint8_t bus)
+{
+	I2CBUS_bus_t *b = &buses[bus];
+	uint8_t p;
+
+	if (b->active)
+	{
+		return true;
+	}
+	for (p = 0; p < I2CBUS_PRIO_COUNT; p++)
+	{
+		if (b->head[p])
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/*!
+    @brief  Get the counters of a bus.
+    @param  bus
+            I2CBUS_bus_id_t.
+    @param  out
+            Receives the counters.
+    @return None (void).
+*/
+void I2CBUS_get_stats(uint8_t bus, I2CBUS_stats_t *out)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	*out = buses[bus].stats;
+	__set_PRIMASK(primask);
+}
+
+/*!
+    @brief  Clear the counters of all buses.
+    @return None (void).
+*/
+void I2CBUS_reset_stats(void)
+{
+	uint32_t primask = __get_PRIMASK();
+	uint8_t i;
+
+	__disable_irq();
+	for (i = 0; i < I2CBUS_BUSES; i++)
+	{
+		memset(&buses[i].stats, 0, sizeof(buses[i].stats));
+	}
+	__set_PRIMASK(primask);
+}
+
+/*!
+    @brief  Serve events of register level writes, call from the bus's
+            I2Cx_EV_IRQHandler() before the HAL handler.
+    @param  bus
+            I2CBUS_bus_id_t.
+    @return None (void).
+*/
+void I2CBUS_irq_handler(uint8_t bus)
+{
+#if I2CBUS_LL
+	I2CBUS_bus_t *b = &buses[bus];
+	I2C_TypeDef *i2c = b->hi2c->Instance;
+	uint32_t isr;
+	uint16_t n;
+
+	if (!b->ll_active)
+	{
+		return;
+	}
+
+	isr = i2c->ISR;
+	if ((isr & I2C_ISR_TXIS) && (i2c->CR1 & I2C_CR1_TXIE))
+	{
+		// Register byte, DMA answers the following TXIS requests
+		i2c->TXDR = b->ll_reg;
+		i2c->CR1 = (i2c->CR1 & ~I2C_CR1_TXIE) | I2C_CR1_TXDMAEN;
+	}
+	if (isr & I2C_ISR_NACKF)
+	{
+		i2c->ICR = I2C_ICR_NACKCF;
+		b->ll_nack = true;
+		if (!(i2c->CR2 & I2C_CR2_AUTOEND))
+		{
+			// No automatic STOP in reload mode
+			i2c->CR2 |= I2C_CR2_STOP;
+		}
+	}
+	else if (isr & I2C_ISR_TCR)
+	{
+		n = (b->ll_left > 255) ? 255 : b->ll_left;
+		b->ll_left -= n;
+		i2c->CR2 = (i2c->CR2 & ~(I2C_CR2_NBYTES | I2C_CR2_RELOAD)) | ((uint32_t)n << I2C_CR2_NBYTES_Pos) |
+				(b->ll_left ? I2C_CR2_RELOAD : I2C_CR2_AUTOEND);
+	}
+	if (isr & I2C_ISR_STOPF)
+	{
+		i2c->ICR = I2C_ICR_STOPCF;
+		i2c->CR1 &= ~(I2C_CR1_TXIE | I2C_CR1_TCIE | I2C_CR1_STOPIE | I2C_CR1_NACKIE | I2C_CR1_TXDMAEN);
+		b->hi2c->hdmatx->Instance->CCR &= ~DMA_CCR_EN;
+		if (b->ll_nack)
+		{
+			// Flush a byte left in TXDR
+			i2c->ISR |= I2C_ISR_TXE;
+			PROF_record(PROF_I2C_ERROR, PROF_CYCLES() - b->chunk_start);
+			TRACE(TRACE_I2C_ERROR, HAL_I2C_ERROR_AF);
+		}
+		else
+		{
+			PROF_record(PROF_I2C_TRANSFER, PROF_CYCLES() - b->chunk_start);
+			TRACE(TRACE_DMA_DONE, 0);
+		}
+		b->ll_active = false;
+		I2CBUS_chunk_done(b, !b->ll_nack);
+	}
+#else
+	(void)bus;
+#endif
+}
+
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	I2CBUS_bus_t *b = I2CBUS_find(hi2c);
+
+	if (b)
+	{
+		PROF_record(PROF_I2C_TRANSFER, PROF_CYCLES() - b->chunk_start);
+		TRACE(TRACE_DMA_DONE, 0);
+		I2CBUS_chunk_done(b, true);
+	}
+}
+
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	I2CBUS_bus_t *b = I2CBUS_find(hi2c);
+
+	if (b)
+	{
+		PROF_record(PROF_I2C_TRANSFER, PROF_CYCLES() - b->chunk_start);
+		TRACE(TRACE_DMA_DONE, 0);
+		I2CBUS_chunk_done(b, true);
+	}
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+	I2CBUS_bus_t *b = I2CBUS_find(hi2c);
+
+	if (b)
+	{
+		PROF_record(PROF_I2C_ERROR, PROF_CYCLES() - b->chunk_start);
+		TRACE(TRACE_I2C_ERROR, hi2c->ErrorCode);
+		I2CBUS_chunk_done(b, false);
+	}
+}
@@ -0,0 +1,284 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include "M2M.h"
+#ifdef USE_HAL_DRIVER
+#include "main.h"
+#include "SCHED.h"
+
+#define M2M_CHANNEL DMA2_Channel1
+#define M2M_MAX_ITEMS 0xFFFF	//< CNDTR is 16 bits
+#endif
+
+typedef struct
+{
+	uint8_t *dst;
+	const uint8_t *src;
+	uint16_t dst_stride;
+	uint16_t src_stride;
+	uint32_t width;			//< Bytes per row
+	uint16_t rows;			//< Rows left, the current one included
+	uint32_t offset;		//< Bytes of the current row done
+	uint32_t size;			//< Bytes on the channel
+	bool fill;				//< src is fill_word, not incremented
+	M2M_done_t done;
+	void *ctx;
+	volatile bool busy;
+} M2M_op_t;
+
+static M2M_op_t op;
+static uint32_t fill_word;	// Source of fills, read by DMA
+
+static void M2M_finish(void)
+{
+	op.busy = false;
+	if (op.done)
+	{
+#ifdef USE_HAL_DRIVER
+		SCHED_complete(op.done, op.ctx);
+#else
+		op.done(op.ctx);
+#endif
+	}
+}
+
+#ifdef USE_HAL_DRIVER
+/*
+ * Put the next piece of the current row on the channel, 32 bits at a
+ * time while both ends are word aligned.
+ */
+static void M2M_start_piece(void)
+{
+	uint8_t *d = op.dst + op.offset;
+	const uint8_t *s = op.fill ? (const uint8_t *)&fill_word : op.src + op.offset;
+	uint32_t left = op.width - op.offset, items;
+	uint32_t ccr = DMA_CCR_MEM2MEM | DMA_CCR_MINC | DMA_CCR_TCIE | DMA_CCR_TEIE;
+
+	if (!op.fill)
+	{
+		ccr |= DMA_CCR_PINC;
+	}
+	if (!(((uint32_t)d | (uint32_t)s) & 3) && (left >= 4))
+	{
+		ccr |= DMA_CCR_PSIZE_1 | DMA_CCR_MSIZE_1;
+		items = (left / 4 > M2M_MAX_ITEMS) ? M2M_MAX_ITEMS : left / 4;
+		op.size = items * 4;
+	}
+	else
+	{
+		items = (left > M2M_MAX_ITEMS) ? M2M_MAX_ITEMS : left;
+		op.size = items;
+	}
+
+	// Source on the peripheral side, DIR clear reads from there
+	M2M_CHANNEL->CCR = 0;
+	M2M_CHANNEL->CPAR = (uint32_t)s;
+	M2M_CHANNEL->CMAR = (uint32_t)d;
+	M2M_CHANNEL->CNDTR = items;
+	M2M_CHANNEL->CCR = ccr | DMA_CCR_EN;
+}
+#endif
+
+/* Wait for the channel, then start on rows of width bytes */
+static void M2M_start(uint8_t *dst, uint16_t dst_stride, const uint8_t *src, uint16_t src_stride, bool fill, uint32_t width, uint16_t rows, M2M_done_t done, void *ctx)
+{
+	M2M_wait();
+	op.dst = dst;
+	op.dst_stride = dst_stride;
+	op.src = src;
+	op.src_stride = src_stride;
+	op.fill = fill;
+	op.width = width;
+	op.rows = rows;
+	op.offset = 0;
+	op.done = done;
+	op.ctx = ctx;
+	op.busy = true;
+	if (!width || !rows)
+	{
+		M2M_finish();
+		return;
+	}
+#ifdef USE_HAL_DRIVER
+	M2M_start_piece();
+#else
+	for (; op.rows; op.rows--)
+	{
+		if (fill)
+		{
+			memset(op.dst, fill_word & 0xFF, width);
+		}
+		else
+		{
+			memcpy(op.dst, op.src, width);
+			op.src += op.src_stride;
+		}
+		op.dst += op.dst_stride;
+	}
+	M2M_finish();
+#endif
+}
+
+/*!
+    @brief  Clock the DMA controller and enable the channel interrupt.
+    @return None (void).
+*/
+void M2M_init(void)
+{
+#ifdef USE_HAL_DRIVER
+	__HAL_RCC_DMA2_CLK_ENABLE();
+	HAL_NVIC_SetPriority(DMA2_Channel1_IRQn, 0, 0);
+	HAL_NVIC_EnableIRQ(DMA2_Channel1_IRQn);
+#endif
+}
+
+/*!
+    @brief  Fill memory with a byte in the background.
+    @param  dst
+            Memory to fill.
+    @param  value
+            Byte to fill with.
+    @param  len
+            Bytes.
+    @param  done
+            Called from the main loop when done, may be NULL.
+    @param  ctx
+            Passed to done.
+    @return None (void).
+*/
+void M2M_fill(void *dst, uint8_t value, uint32_t len, M2M_done_t done, void *ctx)
+{
+	M2M_wait();
+	fill_word = value * 0x01010101UL;
+	M2M_start((uint8_t *)dst, 0, NULL, 0, true, len, 1, done, ctx);
+}
+
+/*!
+    @brief  Copy memory in the background.
+    @param  dst
+            Destination, must not overlap src.
+    @param  src
+            Source, left unchanged until done.
+    @param  len
+            Bytes.
+    @param  done
+            Called from the main loop when done, may be NULL.
+    @param  ctx
+            Passed to done.
+    @return None (void).
+*/
+void M2M_copy(void *dst, const void *src, uint32_t len, M2M_done_t done, void *ctx)
+{
+	M2M_start((uint8_t *)dst, 0, (const uint8_t *)src, 0, false, len, 1, done, ctx);
+}
+
+/*!
+    @brief  Copy a rectangle between two arrays of rows in the background.
+    @param  dst
+            First byte of the destination rectangle.
+    @param  dst_stride
+            Bytes from one destination row to the next.
+    @param  src
+            First byte of the source rectangle, left unchanged until done.
+    @param  src_stride
+            Bytes from one source row to the next.
+    @param  width
+            Bytes per row.
+    @param  rows
+            Rows.
+    @param  done
+            Called from the main loop when done, may be NULL.
+    @param  ctx
+            Passed to done.
+    @return None (void).
+    @note   Each row is a DMA transfer of its own, started from the
+            interrupt of the row before.
+*/
+void M2M_copy_rect(void *dst, uint16_t dst_stride, const void *src, uint16_t src_stride, uint16_t width, uint16_t rows, M2M_done_t done, void *ctx)
+{
+	M2M_start((uint8_t *)dst, dst_stride, (const uint8_t *)src, src_stride, false, width, rows, done, ctx);
+}
+
+/*!
+    @brief  Check for an operation in progress.
+    @return true until the last byte has been written, its done callback
+            follows from the main loop.
+*/
+bool M2M_busy(void)
+{
+	return op.busy;
+}
+
+/*!
+    @brief  Wait for the operation in progress, if any.
+    @return None (void).
+    @note   Not from a higher priority interrupt than the DMA channel's.
+*/
+void M2M_wait(void)
+{
+	while (op.busy);
+}
+
+/*!
+    @brief  DMA2 channel 1 interrupt, continues with the next row or piece
+            and reports the end of the operation.
+    @return None (void).
+    @note   Call from DMA2_Channel1_IRQHandler().
+*/
+void M2M_irq_handler(void)
+{
+#ifdef USE_HAL_DRIVER
+	uint32_t isr = DMA2->ISR;
+
+	DMA2->IFCR = DMA_IFCR_CGIF1;
+	M2M_CHANNEL->CCR = 0;
+	if (isr & DMA_ISR_TEIF1)
+	{
+		// Bad address, give up on the rest
+		M2M_finish();
+		return;
+	}
+	if (!(isr & DMA_ISR_TCIF1))
+	{
+		return;
+	}
+
+	op.offset += op.size;
+	if (op.offset == op.width)
+	{
+		op.offset = 0;
+		op.dst += op.dst_stride;
+		if (!op.fill)
+		{
+			op.src += op.src_stride;
+		}
+		if (--op.rows == 0)
+		{
+			M2M_finish();
+			return;
+		}
+	}
+	M2M_start_piece();
+#endif
+}
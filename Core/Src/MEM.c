@@ -0,0 +1,91 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "main.h"
+#include "MEM.h"
+#include "SERIAL.h"
+
+extern uint8_t _sdata, _ebss, _end, _estack;	// Linker script symbols
+extern uint32_t _Min_Stack_Size;
+
+void _sbrk_usage(uint32_t *used, uint32_t *peak, uint32_t *failed);
+
+/* Lowest word above the heap that is no longer painted */
+static const uint32_t * MEM_stack_low(uint32_t heap_peak)
+{
+	const uint32_t *p = (const uint32_t *)(((uint32_t)&_end + heap_peak + 3) & ~3UL);
+
+	while ((p < (const uint32_t *)&_estack) && (*p == MEM_PAINT))
+	{
+		p++;
+	}
+	return p;
+}
+
+/*!
+    @brief  Deepest the main stack has been since reset.
+    @return Bytes, compare with _Min_Stack_Size reserved by the linker
+            script.
+    @note   Scans the painted RAM, which takes up to a few hundred
+            microseconds.
+*/
+uint32_t MEM_stack_high_water(void)
+{
+	uint32_t used, peak, failed;
+
+	_sbrk_usage(&used, &peak, &failed);
+	return (uint8_t *)&_estack - (const uint8_t *)MEM_stack_low(peak);
+}
+
+/*!
+    @brief  Collect RAM usage figures.
+    @param  stats
+            Receives the figures, in bytes.
+    @return None (void).
+*/
+void MEM_get_stats(MEM_stats_t *stats)
+{
+	const uint8_t *low;
+
+	_sbrk_usage(&stats->heap_used, &stats->heap_peak, &stats->heap_failed);
+	low = (const uint8_t *)MEM_stack_low(stats->heap_peak);
+	stats->ram = &_estack - &_sdata;
+	stats->static_used = &_ebss - &_sdata;
+	stats->stack_used = (uint32_t)&_estack - __get_MSP();
+	stats->stack_peak = &_estack - low;
+	stats->free = low - (&_end + stats->heap_peak);
+}
+
+/*!
+    @brief  Print RAM usage in bytes over the serial port.
+    @return None (void).
+*/
+void MEM_report(void)
+{
+	MEM_stats_t s;
+
+	MEM_get_stats(&s);
+	SERIAL_printf("mem: ram %lu static %lu free %lu\r\n", s.ram, s.static_used, s.free);
+	SERIAL_printf("mem: heap %lu peak %lu failed %lu\r\n", s.heap_used, s.heap_peak, s.heap_failed);
+	SERIAL_printf("mem: stack %lu peak %lu reserved %lu\r\n", s.stack_used, s.stack_peak, (uint32_t)&_Min_Stack_Size);
+}
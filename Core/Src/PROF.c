@@ -0,0 +1,203 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include "PROF.h"
+#ifdef USE_HAL_DRIVER
+#include "main.h"
+#include "SERIAL.h"
+#endif
+
+static const char * const names[PROF_POINTS] =
+{
+	"draw_char",
+	"draw_string",
+	"draw_text_box",
+	"fill_rect",
+	"hline",
+	"vline",
+	"clear",
+	"repaint",
+	"repaint_page",
+	"i2c_transfer",
+	"i2c_error",
+	"irq_systick",
+	"irq_i2c1_dma",
+	"irq_i2c1_ev",
+	"irq_usart2",
+	"irq_usart2_dma",
+	"irq_exti15_10",
+	"irq_i2c2_dma",
+	"irq_i2c2_ev",
+	"irq_m2m_dma",
+};
+
+#if PROF_ENABLE
+static PROF_stat_t stats[PROF_POINTS];
+#endif
+
+/*!
+    @brief  Start the DWT cycle counter and clear all statistics.
+    @return None (void).
+    @note   The cycle counter is started even with PROF_ENABLE 0, for
+            other users of PROF_CYCLES() such as the self-test.
+*/
+void PROF_init(void)
+{
+#ifdef USE_HAL_DRIVER
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+	PROF_reset();
+}
+
+/*!
+    @brief  Clear all statistics.
+    @return None (void).
+*/
+void PROF_reset(void)
+{
+#if PROF_ENABLE
+	uint32_t primask = __get_PRIMASK();
+	uint8_t i;
+
+	__disable_irq();
+	memset(stats, 0, sizeof(stats));
+	for (i = 0; i < PROF_POINTS; i++)
+	{
+		stats[i].min = UINT32_MAX;
+	}
+	__set_PRIMASK(primask);
+#endif
+}
+
+/*!
+    @brief  Account one call of a profiling point, normally through
+            PROF_END().
+    @param  id
+            Profiling point.
+    @param  cycles
+            Duration of the call.
+    @return None (void).
+*/
+void PROF_record(PROF_point_t id, uint32_t cycles)
+{
+#if PROF_ENABLE
+	PROF_stat_t *s = &stats[id];
+	uint8_t bucket = 32 - __CLZ(cycles);
+
+	s->count++;
+	s->total += cycles;
+	if (cycles < s->min)
+	{
+		s->min = cycles;
+	}
+	if (cycles > s->max)
+	{
+		s->max = cycles;
+	}
+	s->hist[(bucket < PROF_HIST_BUCKETS) ? bucket : PROF_HIST_BUCKETS - 1]++;
+#else
+	(void)id;
+	(void)cycles;
+#endif
+}
+
+/*!
+    @brief  Take a consistent copy of the statistics of one point.
+    @param  id
+            Profiling point.
+    @param  stat
+            Receives the statistics, all zero when profiling is compiled
+            out.
+    @return None (void).
+*/
+void PROF_get(PROF_point_t id, PROF_stat_t *stat)
+{
+#if PROF_ENABLE
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	*stat = stats[id];
+	__set_PRIMASK(primask);
+#else
+	(void)id;
+	memset(stat, 0, sizeof(*stat));
+#endif
+}
+
+/*!
+    @brief  Name of a profiling point.
+    @param  id
+            Profiling point.
+    @return Zero terminated name.
+*/
+const char * PROF_get_name(PROF_point_t id)
+{
+	return (id < PROF_POINTS) ? names[id] : "?";
+}
+
+/*!
+    @brief  Print the statistics of every point that was hit over the
+            serial port, one line per point:
+            "prof: name count total min max mean | bucket:count ...".
+    @return None (void).
+    @note   Blocks until sent, cycle counts are CPU clock cycles.
+*/
+void PROF_dump(void)
+{
+#if PROF_ENABLE
+	PROF_stat_t s;
+	uint8_t i, b;
+
+	SERIAL_printf("prof: %lu cycles/us\r\n", SystemCoreClock / 1000000);
+	for (i = 0; i < PROF_POINTS; i++)
+	{
+		PROF_get(i, &s);
+		if (s.count == 0)
+		{
+			continue;
+		}
+		// No 64-bit conversions in the formatter, print the total in two parts
+		SERIAL_printf("prof: %s %lu ", names[i], s.count);
+		if (s.total >= 1000000000)
+		{
+			SERIAL_printf("%lu%09lu", (uint32_t)(s.total / 1000000000), (uint32_t)(s.total % 1000000000));
+		}
+		else
+		{
+			SERIAL_printf("%lu", (uint32_t)s.total);
+		}
+		SERIAL_printf(" %lu %lu %lu |", s.min, s.max, (uint32_t)(s.total / s.count));
+		for (b = 0; b < PROF_HIST_BUCKETS; b++)
+		{
+			if (s.hist[b])
+			{
+				SERIAL_printf(" %u:%lu", b, s.hist[b]);
+			}
+		}
+		SERIAL_print("\r\n");
+	}
+#endif
+}
@@ -0,0 +1,315 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "RFB.h"
+#include "SERIAL.h"
+#include "TRACE.h"
+
+#define RFB_BUFFER_SIZE (SSD1306_WIDTH * ((SSD1306_HEIGHT + 7) / 8))
+
+typedef enum
+{
+	RFB_STATE_SYNC1,
+	RFB_STATE_SYNC2,
+	RFB_STATE_TYPE,
+	RFB_STATE_LEN_L,
+	RFB_STATE_LEN_H,
+	RFB_STATE_PAYLOAD,
+	RFB_STATE_CRC_L,
+	RFB_STATE_CRC_H
+} RFB_state_t;
+
+static RFB_state_t state;
+static uint8_t type;
+static uint16_t length, received, crc, frame_crc;
+static bool bad;			// Payload ran outside the buffer or was malformed
+static RFB_stats_t stats;
+
+/* Payload decoder state */
+static uint8_t *buffer;
+static uint16_t offset;		// Next buffer byte to write
+static uint16_t count;		// Literal/run/patch bytes left
+static uint8_t header[3];	// Delta patch header being collected
+static uint8_t header_len;
+static bool run;			// RLE run waiting for its value byte
+static uint8_t pages;		// Pages touched by a delta frame, one bit each
+
+static uint16_t RFB_crc16(uint16_t crc, uint8_t b)
+{
+	uint8_t i;
+
+	crc ^= (uint16_t)b << 8;
+	for (i = 0; i < 8; i++)
+	{
+		crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+	}
+	return crc;
+}
+
+static void RFB_store(uint8_t b)
+{
+	if (offset >= RFB_BUFFER_SIZE)
+	{
+		bad = true;
+		return;
+	}
+	pages |= 1 << (offset / SSD1306_WIDTH);
+	buffer[offset++] = b;
+}
+
+static void RFB_payload(uint8_t b)
+{
+	if (bad)
+	{
+		return;		// Rejected, drain the rest without touching the buffer
+	}
+
+	switch (type)
+	{
+		case RFB_FRAME_FULL:
+			RFB_store(b);
+			break;
+
+		case RFB_FRAME_RLE:
+			if (run)
+			{
+				while (count--)
+				{
+					RFB_store(b);
+				}
+				count = 0;
+				run = false;
+			}
+			else if (count)
+			{
+				RFB_store(b);
+				count--;
+			}
+			else if (b & 0x80)
+			{
+				count = (b & 0x7F) + 2;
+				run = true;
+			}
+			else
+			{
+				count = b + 1;
+			}
+			break;
+
+		case RFB_FRAME_DELTA:
+			if (count)
+			{
+				RFB_store(b);
+				count--;
+			}
+			else
+			{
+				header[header_len++] = b;
+				if (header_len == sizeof(header))
+				{
+					header_len = 0;
+					offset = header[0] * SSD1306_WIDTH + header[1];
+					count = header[2];
+					if ((header[1] >= SSD1306_WIDTH) || (count == 0) || ((uint32_t)offset + count > RFB_BUFFER_SIZE))
+					{
+						bad = true;
+					}
+				}
+			}
+			break;
+
+		default:
+			bad = true;
+			break;
+	}
+}
+
+static void RFB_complete(void)
+{
+	uint8_t ack = RFB_NAK, p;
+
+	if ((type == RFB_FRAME_RLE) && (offset != RFB_BUFFER_SIZE))
+	{
+		bad = true;		// Decoded short of the whole buffer
+	}
+	if (!bad && (crc == frame_crc) && (count == 0) && !run && (header_len == 0))
+	{
+		if ((type == RFB_FRAME_DELTA) && ((SSD1306_get_buffer_rotation() & 1) == 0))
+		{
+			// The buffer is in display RAM layout whatever the rotation
+			for (p = 0; p < (SSD1306_HEIGHT + 7) / 8; p++)
+			{
+				if (pages & (1 << p))
+				{
+					SSD1306_display_repaint_page(p);
+				}
+			}
+		}
+		else
+		{
+			SSD1306_display_repaint();
+		}
+		stats.frames++;
+		ack = RFB_ACK;
+	}
+	else
+	{
+		stats.errors++;
+		TRACE(TRACE_FRAME_DROP, type);
+	}
+
+	SERIAL_write(&ack, 1);
+}
+
+/*!
+    @brief  Reset the frame decoder.
+    @return None (void).
+*/
+void RFB_init(void)
+{
+	state = RFB_STATE_SYNC1;
+	buffer = SSD1306_get_buffer();
+}
+
+/*!
+    @brief  Decode received bytes, repainting each completed frame.
+    @param  data
+            Bytes from the host, frames may be split at any point.
+    @param  len
+            Number of bytes.
+    @return Bytes taken, fewer than len when a frame's payload is about to
+            start while the previous frame is still on its way to the
+            panel. Feed the rest again later.
+    @note   Payloads are decoded in place as they arrive, so a frame that
+            later fails its CRC may leave the buffer partly updated. It is
+            not repainted and the host is expected to resend.
+*/
+uint16_t RFB_feed(const uint8_t *data, uint16_t len)
+{
+	const uint8_t *start = data;
+	uint8_t b;
+
+	while (len)
+	{
+		if ((state == RFB_STATE_PAYLOAD) && (received == 0) && SSD1306_display_busy())
+		{
+			break;
+		}
+		len--;
+		b = *data++;
+		switch (state)
+		{
+			case RFB_STATE_SYNC1:
+				if (b == RFB_SYNC1)
+				{
+					state = RFB_STATE_SYNC2;
+				}
+				break;
+			case RFB_STATE_SYNC2:
+				state = (b == RFB_SYNC2) ? RFB_STATE_TYPE : ((b == RFB_SYNC1) ? RFB_STATE_SYNC2 : RFB_STATE_SYNC1);
+				break;
+			case RFB_STATE_TYPE:
+				type = b;
+				crc = RFB_crc16(0xFFFF, b);
+				state = RFB_STATE_LEN_L;
+				break;
+			case RFB_STATE_LEN_L:
+				length = b;
+				crc = RFB_crc16(crc, b);
+				state = RFB_STATE_LEN_H;
+				break;
+			case RFB_STATE_LEN_H:
+				length |= (uint16_t)b << 8;
+				crc = RFB_crc16(crc, b);
+				if (length > RFB_MAX_PAYLOAD)
+				{
+					stats.errors++;
+					TRACE(TRACE_FRAME_DROP, type);
+					state = RFB_STATE_SYNC1;
+					break;
+				}
+				received = 0;
+				offset = 0;
+				count = 0;
+				header_len = 0;
+				run = false;
+				// A short full frame is drained without touching the buffer
+				bad = (type == RFB_FRAME_FULL) && (length != RFB_BUFFER_SIZE);
+				pages = 0;
+				buffer = SSD1306_get_buffer();
+				state = length ? RFB_STATE_PAYLOAD : RFB_STATE_CRC_L;
+				break;
+			case RFB_STATE_PAYLOAD:
+				crc = RFB_crc16(crc, b);
+				RFB_payload(b);
+				if (++received == length)
+				{
+					state = RFB_STATE_CRC_L;
+				}
+				break;
+			case RFB_STATE_CRC_L:
+				frame_crc = b;
+				state = RFB_STATE_CRC_H;
+				break;
+			case RFB_STATE_CRC_H:
+				frame_crc |= (uint16_t)b << 8;
+				RFB_complete();
+				state = RFB_STATE_SYNC1;
+				break;
+		}
+	}
+	return data - start;
+}
+
+/*!
+    @brief  Poll function for the main loop, decodes received serial data.
+    @return None (void).
+    @note   Returns without waiting while the previous frame is still
+            being sent, the data left waits for a later pass.
+*/
+void RFB_process(void)
+{
+	static uint8_t chunk[64];
+	static uint16_t pos, len;
+
+	do
+	{
+		if (pos == len)
+		{
+			pos = 0;
+			len = SERIAL_read(chunk, sizeof(chunk));
+		}
+		pos += RFB_feed(&chunk[pos], len - pos);
+	} while (len && (pos == len));
+}
+
+/*!
+    @brief  Read decoder counters.
+    @param  s
+            Filled with the counters collected since startup.
+    @return None (void).
+*/
+void RFB_get_stats(RFB_stats_t *s)
+{
+	*s = stats;
+}
@@ -0,0 +1,285 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "main.h"
+#include "SCHED.h"
+#include "SERIAL.h"
+
+typedef struct
+{
+	SCHED_fn_t fn;
+	void *ctx;
+} SCHED_event_t;
+
+static SCHED_event_t queue[SCHED_QUEUE];
+static uint8_t head, tail;			// Oldest queued, next free
+static volatile uint8_t queued;
+static SCHED_timer_t *timers;		// Active timers, soonest first
+static SCHED_poll_t polls[SCHED_POLLS];
+static uint8_t poll_count;
+static SCHED_stats_t stats;
+
+/* Take the oldest deferred callback off the queue */
+static bool SCHED_take(SCHED_event_t *e)
+{
+	uint32_t primask = __get_PRIMASK();
+	bool ok = false;
+
+	__disable_irq();
+	if (queued)
+	{
+		*e = queue[head];
+		head = (head + 1) % SCHED_QUEUE;
+		queued--;
+		ok = true;
+	}
+	__set_PRIMASK(primask);
+	return ok;
+}
+
+/* Add a timer to the list, behind those due at the same time */
+static void SCHED_insert(SCHED_timer_t *t)
+{
+	SCHED_timer_t **p = &timers;
+
+	while (*p && ((int32_t)((*p)->due - t->due) <= 0))
+	{
+		p = &(*p)->next;
+	}
+	t->next = *p;
+	*p = t;
+	t->active = true;
+}
+
+/*!
+    @brief  Queue a callback to run from the main loop.
+    @param  fn
+            Callback.
+    @param  ctx
+            Passed to fn.
+    @return false if the queue is full, the callback is dropped.
+    @note   Safe from interrupt handlers, e.g. to hand the completion of
+            a transfer over to thread context. Callbacks run in the order
+            they were posted.
+*/
+bool SCHED_post(SCHED_fn_t fn, void *ctx)
+{
+	uint32_t primask = __get_PRIMASK();
+	bool ok = false;
+
+	__disable_irq();
+	if (queued < SCHED_QUEUE)
+	{
+		queue[tail].fn = fn;
+		queue[tail].ctx = ctx;
+		tail = (tail + 1) % SCHED_QUEUE;
+		queued++;
+		if (queued > stats.max_queued)
+		{
+			stats.max_queued = queued;
+		}
+		ok = true;
+	}
+	else
+	{
+		stats.dropped++;
+	}
+	__set_PRIMASK(primask);
+	return ok;
+}
+
+/*!
+    @brief  Hand the completion of a transfer over to the main loop.
+    @param  fn
+            Completion callback.
+    @param  ctx
+            Passed to fn.
+    @return None (void).
+    @note   For drivers reporting from their interrupt handlers. Should
+            the queue be full, fn runs right away instead, still in the
+            interrupt, so that no completion is lost. That is counted as
+            dropped.
+*/
+void SCHED_complete(SCHED_fn_t fn, void *ctx)
+{
+	if (!SCHED_post(fn, ctx))
+	{
+		fn(ctx);
+	}
+}
+
+/*!
+    @brief  Start or restart a timer.
+    @param  t
+            Caller owned timer, left untouched by the caller while active.
+    @param  fn
+            Called from the main loop when the timer expires.
+    @param  ctx
+            Passed to fn.
+    @param  delay_ms
+            Time to the first call.
+    @param  period_ms
+            Time between later calls, 0 for a single call.
+    @return None (void).
+    @note   From thread context only, timer callbacks included. An
+            interrupt handler posts a callback that starts the timer.
+            A periodic timer that falls behind skips the calls it missed.
+*/
+void SCHED_timer_start(SCHED_timer_t *t, SCHED_fn_t fn, void *ctx, uint32_t delay_ms, uint32_t period_ms)
+{
+	SCHED_timer_stop(t);
+	t->fn = fn;
+	t->ctx = ctx;
+	t->period = period_ms;
+	t->due = HAL_GetTick() + delay_ms;
+	SCHED_insert(t);
+}
+
+/*!
+    @brief  Stop a timer, if active.
+    @param  t
+            Timer to stop.
+    @return None (void).
+*/
+void SCHED_timer_stop(SCHED_timer_t *t)
+{
+	SCHED_timer_t **p = &timers;
+
+	if (!t->active)
+	{
+		return;
+	}
+	while (*p != t)
+	{
+		p = &(*p)->next;
+	}
+	*p = t->next;
+	t->active = false;
+}
+
+/*!
+    @brief  Call a function on every pass of the main loop.
+    @param  fn
+            Poller, must return without waiting for input.
+    @return false if SCHED_POLLS pollers are registered already.
+*/
+bool SCHED_add_poll(SCHED_poll_t fn)
+{
+	if (poll_count >= SCHED_POLLS)
+	{
+		return false;
+	}
+	polls[poll_count++] = fn;
+	return true;
+}
+
+/*!
+    @brief  One pass of the main loop, call it from while (1).
+    @return None (void).
+    @note   Runs the callbacks posted before the pass, then the timers due
+            and the pollers, then sleeps until the next interrupt if
+            nothing new was posted and no timer is due.
+*/
+void SCHED_run_once(void)
+{
+	SCHED_event_t e;
+	SCHED_timer_t *t;
+	uint32_t now;
+	uint8_t i, n;
+
+	stats.passes++;
+	// Callbacks posted meanwhile wait for the next pass, timers and pollers go first
+	for (n = queued; n && SCHED_take(&e); n--)
+	{
+		stats.posted++;
+		e.fn(e.ctx);
+	}
+
+	now = HAL_GetTick();
+	while (timers && ((int32_t)(now - timers->due) >= 0))
+	{
+		t = timers;
+		timers = t->next;
+		t->active = false;
+		if (t->period)
+		{
+			// Back in the list before the call, so fn may stop it
+			t->due += t->period;
+			if ((int32_t)(now - t->due) >= 0)
+			{
+				t->due = now + t->period;
+			}
+			SCHED_insert(t);
+		}
+		stats.timers++;
+		t->fn(t->ctx);
+	}
+
+	for (i = 0; i < poll_count; i++)
+	{
+		polls[i]();
+	}
+
+#if SCHED_SLEEP
+	{
+		uint32_t primask = __get_PRIMASK();
+
+		// With interrupts masked, one arriving after the check still ends WFI
+		__disable_irq();
+		if (!queued && !(timers && ((int32_t)(HAL_GetTick() - timers->due) >= 0)))
+		{
+			stats.sleeps++;
+			__WFI();
+		}
+		__set_PRIMASK(primask);
+	}
+#endif
+}
+
+/*!
+    @brief  Get the scheduler statistics since reset.
+    @param  out
+            Receives the counters.
+    @return None (void).
+*/
+void SCHED_get_stats(SCHED_stats_t *out)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	*out = stats;
+	__set_PRIMASK(primask);
+}
+
+/*!
+    @brief  Print the scheduler statistics to USART2.
+    @return None (void).
+*/
+void SCHED_report(void)
+{
+	SCHED_stats_t s;
+
+	SCHED_get_stats(&s);
+	SERIAL_printf("sched: passes %lu sleeps %lu timers %lu\r\n", s.passes, s.sleeps, s.timers);
+	SERIAL_printf("sched: posted %lu dropped %lu max_queued %lu\r\n", s.posted, s.dropped, s.max_queued);
+}
@@ -0,0 +1,209 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "main.h"
+#include "SELFTEST.h"
+#include "GFX.h"
+#include "SERIAL.h"
+#include "PROF.h"
+
+typedef void (*SELFTEST_draw_t)(uint32_t frame);
+typedef void (*SELFTEST_plot_t)(int16_t x, int16_t y, uint16_t color);
+
+static void SELFTEST_fill(uint32_t frame);
+static void SELFTEST_checker(uint32_t frame);
+static void SELFTEST_text(uint32_t frame);
+static void SELFTEST_bars(uint32_t frame);
+
+static const struct
+{
+	const char *name;
+	SELFTEST_draw_t draw;
+} patterns[] =
+{
+	{ "fill", SELFTEST_fill },
+	{ "check", SELFTEST_checker },
+	{ "text", SELFTEST_text },
+	{ "bars", SELFTEST_bars },
+};
+
+#define SELFTEST_PATTERNS (sizeof(patterns) / sizeof(patterns[0]))
+
+static SELFTEST_result_t results[SELFTEST_PATTERNS];
+static uint32_t pixel_cycles[2];	// Per pixel, byte read-modify-write and atomic
+
+/* Whole screen on and off on alternate frames */
+static void SELFTEST_fill(uint32_t frame)
+{
+	GFX_draw_fill_rect(0, 0, WIDTH, HEIGHT, (frame & 1) ? WHITE : BLACK);
+}
+
+/* 8x8 checkerboard, inverted every frame */
+static void SELFTEST_checker(uint32_t frame)
+{
+	int16_t x, y;
+
+	for (y = 0; y < HEIGHT; y += 8)
+	{
+		for (x = 0; x < WIDTH; x += 8)
+		{
+			GFX_draw_fill_rect(x, y, 8, 8, (((x + y) >> 3) + frame) & 1 ? WHITE : BLACK);
+		}
+	}
+}
+
+/* Full screen of text, the worst case for the glyph renderer */
+static void SELFTEST_text(uint32_t frame)
+{
+	uint8_t line;
+
+	SSD1306_display_clear();
+	for (line = 0; line < HEIGHT / GFX_CHAR_HEIGHT; line++)
+	{
+		GFX_set_cursor(0, line * GFX_CHAR_HEIGHT);
+		GFX_printf("%02u %08lX %05lu", line, frame * 0x9E3779B1UL, frame);
+	}
+}
+
+/* Vertical bars sweeping across the screen */
+static void SELFTEST_bars(uint32_t frame)
+{
+	int16_t x;
+
+	SSD1306_display_clear();
+	for (x = frame % 16; x < WIDTH; x += 16)
+	{
+		SSD1306_draw_fast_vline(x, 0, HEIGHT, WHITE);
+		SSD1306_draw_fast_vline(x + 1, 0, HEIGHT, WHITE);
+	}
+}
+
+/* Run one pattern back to back for SELFTEST_PATTERN_MS */
+static void SELFTEST_measure(SELFTEST_draw_t draw, SELFTEST_result_t *r)
+{
+	uint32_t cycles_per_us = SystemCoreClock / 1000000;
+	uint32_t draw_cycles = 0, xfer_cycles = 0, total_cycles = 0;
+	uint32_t start, t0, t1, t2;
+
+	r->frames = 0;
+	start = HAL_GetTick();
+	do
+	{
+		t0 = PROF_CYCLES();
+		draw(r->frames);
+		t1 = PROF_CYCLES();
+		SSD1306_display_repaint();
+		SSD1306_display_wait();
+		t2 = PROF_CYCLES();
+
+		draw_cycles += t1 - t0;
+		xfer_cycles += t2 - t1;
+		total_cycles += t2 - t0;
+		r->frames++;
+	} while (HAL_GetTick() - start < SELFTEST_PATTERN_MS);
+	r->ms = HAL_GetTick() - start;
+
+	r->fps_x10 = r->frames * 10000 / r->ms;
+	r->bytes_per_s = r->frames * SELFTEST_FRAME_BYTES * 1000 / r->ms;
+	r->busy_pct = (uint64_t)xfer_cycles * 100 / total_cycles;
+	r->draw_us = draw_cycles / cycles_per_us / r->frames;
+	r->xfer_us = xfer_cycles / cycles_per_us / r->frames;
+}
+
+/* Cycles per pixel of plotting a checkerboard over the whole screen */
+static uint32_t SELFTEST_pixels(SELFTEST_plot_t plot)
+{
+	uint32_t t0 = PROF_CYCLES();
+	int16_t x, y;
+
+	for (y = 0; y < HEIGHT; y++)
+	{
+		for (x = 0; x < WIDTH; x++)
+		{
+			plot(x, y, ((x ^ y) & 1) ? WHITE : BLACK);
+		}
+	}
+	return (PROF_CYCLES() - t0) / (WIDTH * HEIGHT);
+}
+
+static void SELFTEST_report(void)
+{
+	SELFTEST_result_t *r;
+	uint8_t i;
+
+	SSD1306_display_clear();
+	GFX_set_text_size(1, 1);
+	GFX_set_text_wrap(false);
+	GFX_set_cursor(0, 0);
+	SERIAL_print("selftest: pattern frames ms fps bytes/s busy% draw_us xfer_us\r\n");
+	for (i = 0; i < SELFTEST_PATTERNS; i++)
+	{
+		r = &results[i];
+		GFX_printf("%-5s%3lu.%lufps %3u%%\n", r->name, r->fps_x10 / 10, r->fps_x10 % 10, r->busy_pct);
+		GFX_printf(" %2lu.%luK %lu/%luus\n", r->bytes_per_s / 1000, r->bytes_per_s % 1000 / 100, r->draw_us, r->xfer_us);
+		SERIAL_printf("selftest: %s %lu %lu %lu.%lu %lu %u %lu %lu\r\n", r->name, r->frames, r->ms,
+				r->fps_x10 / 10, r->fps_x10 % 10, r->bytes_per_s, r->busy_pct, r->draw_us, r->xfer_us);
+	}
+	SERIAL_printf("selftest: pixel cycles rmw %lu atomic %lu\r\n", pixel_cycles[0], pixel_cycles[1]);
+	SSD1306_display_repaint();
+	PROF_dump();
+}
+
+/*!
+    @brief  Run every test pattern and report the results.
+    @return None (void).
+    @note   Takes about SELFTEST_PATTERN_MS per pattern and blocks for
+            the whole time. Leaves the results on the panel and dumps the
+            profiling statistics of the run. The cost per pixel of
+            SSD1306_draw_pixel() and SSD1306_draw_pixel_atomic() goes to
+            USART2 only.
+*/
+void SELFTEST_run(void)
+{
+	uint8_t i;
+
+	PROF_init();
+	GFX_set_text_size(1, 1);
+	GFX_set_text_color(WHITE, BLACK);
+	GFX_set_text_wrap(false);
+	for (i = 0; i < SELFTEST_PATTERNS; i++)
+	{
+		results[i].name = patterns[i].name;
+		SELFTEST_measure(patterns[i].draw, &results[i]);
+	}
+	pixel_cycles[0] = SELFTEST_pixels(SSD1306_draw_pixel);
+	pixel_cycles[1] = SELFTEST_pixels(SSD1306_draw_pixel_atomic);
+	SELFTEST_report();
+}
+
+/*!
+    @brief  Results of the last SELFTEST_run().
+    @param  count
+            Receives the number of results.
+    @return Pointer to the results, one per test pattern.
+*/
+const SELFTEST_result_t * SELFTEST_get_results(uint8_t *count)
+{
+	*count = SELFTEST_PATTERNS;
+	return results;
+}
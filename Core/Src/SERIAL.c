@@ -0,0 +1,264 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include "SERIAL.h"
+#include "FORMAT.h"
+#include "SCHED.h"
+#include "TRACE.h"
+
+#define RX_MASK (SERIAL_RX_BUFFER_SIZE - 1)
+
+typedef struct
+{
+	uint8_t buf[64];
+	uint8_t len;
+} SERIAL_print_ctx_t;
+
+static uint8_t rx_buf[SERIAL_RX_BUFFER_SIZE];
+static volatile uint16_t rx_head;	// Written by the ISR only
+static volatile uint16_t rx_tail;	// Written by the reader only
+static volatile bool rx_idle;
+static volatile uint32_t rx_dropped;
+static volatile SERIAL_tx_done_t tx_done;
+static void *tx_ctx;
+
+/*!
+    @brief  Start interrupt driven reception on the serial port.
+    @return None (void).
+*/
+void SERIAL_init(void)
+{
+	rx_head = rx_tail = 0;
+	rx_idle = false;
+
+	__HAL_UART_CLEAR_FLAG(&SERIAL_UART, UART_CLEAR_OREF | UART_CLEAR_IDLEF | UART_CLEAR_FEF | UART_CLEAR_NEF);
+	__HAL_UART_ENABLE_IT(&SERIAL_UART, UART_IT_RXNE);
+	__HAL_UART_ENABLE_IT(&SERIAL_UART, UART_IT_IDLE);
+}
+
+/*!
+    @brief  Number of received bytes waiting to be read.
+    @return Byte count.
+*/
+uint16_t SERIAL_available(void)
+{
+	return (rx_head - rx_tail) & RX_MASK;
+}
+
+/*!
+    @brief  Take received bytes out of the ring buffer.
+    @param  buf
+            Destination.
+    @param  len
+            Maximum number of bytes to copy.
+    @return Number of bytes copied, 0 if nothing was received.
+*/
+uint16_t SERIAL_read(uint8_t *buf, uint16_t len)
+{
+	uint16_t n = 0, tail = rx_tail;
+
+	while (n < len && tail != rx_head)
+	{
+		buf[n++] = rx_buf[tail];
+		tail = (tail + 1) & RX_MASK;
+	}
+	rx_tail = tail;
+	return n;
+}
+
+/*!
+    @brief  Check for the end of a burst of received data.
+    @return true once per idle line period following reception.
+*/
+bool SERIAL_rx_idle(void)
+{
+	bool idle = rx_idle;
+
+	rx_idle = false;
+	return idle;
+}
+
+/*!
+    @brief  Bytes lost to a full ring buffer or receiver overrun.
+    @return Count since startup.
+*/
+uint32_t SERIAL_get_rx_dropped(void)
+{
+	return rx_dropped;
+}
+
+/*!
+    @brief  Start sending a buffer in the background.
+    @param  buf
+            Data, must stay valid until the transfer completes.
+    @param  len
+            Number of bytes.
+    @param  done
+            Called from the main loop when the transfer completed, see
+            SCHED_complete(), may start the next transfer. NULL if not
+            needed.
+    @param  ctx
+            Passed to done.
+    @return false if a transfer is already in progress.
+*/
+bool SERIAL_write_dma(const uint8_t *buf, uint16_t len, SERIAL_tx_done_t done, void *ctx)
+{
+	if (SERIAL_tx_busy())
+	{
+		return false;
+	}
+	tx_done = done;
+	tx_ctx = ctx;
+	if (HAL_UART_Transmit_DMA(&SERIAL_UART, (uint8_t *)buf, len) != HAL_OK)
+	{
+		tx_done = NULL;
+		return false;
+	}
+	return true;
+}
+
+/*!
+    @brief  Check for a transfer in progress.
+    @return true while sending.
+*/
+bool SERIAL_tx_busy(void)
+{
+	return SERIAL_UART.gState == HAL_UART_STATE_BUSY_TX;
+}
+
+/*!
+    @brief  Send a buffer, waiting for any background transfer first.
+    @param  buf
+            Data.
+    @param  len
+            Number of bytes.
+    @return None (void).
+*/
+void SERIAL_write(const uint8_t *buf, uint16_t len)
+{
+	while (SERIAL_tx_busy());
+	HAL_UART_Transmit(&SERIAL_UART, (uint8_t *)buf, len, 100);
+}
+
+/*!
+    @brief  Send a zero terminated string, see SERIAL_write().
+    @param  s
+            Text.
+    @return None (void).
+*/
+void SERIAL_print(const char *s)
+{
+	SERIAL_write((const uint8_t *)s, strlen(s));
+}
+
+/* Collect formatter output, sending it out in blocks */
+static void SERIAL_put(char c, void *ctx)
+{
+	SERIAL_print_ctx_t *p = ctx;
+
+	p->buf[p->len++] = c;
+	if (p->len == sizeof(p->buf))
+	{
+		SERIAL_write(p->buf, p->len);
+		p->len = 0;
+	}
+}
+
+/*!
+    @brief  Formatted print, blocking like SERIAL_write().
+    @param  fmt
+            Format string, see FORMAT_vprint().
+    @return None (void).
+*/
+void SERIAL_printf(const char *fmt, ...)
+{
+	SERIAL_print_ctx_t ctx;
+	va_list args;
+
+	ctx.len = 0;
+	va_start(args, fmt);
+	FORMAT_vprint(SERIAL_put, &ctx, fmt, args);
+	va_end(args);
+	if (ctx.len)
+	{
+		SERIAL_write(ctx.buf, ctx.len);
+	}
+}
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+	SERIAL_tx_done_t done = tx_done;
+
+	if (huart == &SERIAL_UART)
+	{
+		tx_done = NULL;
+		if (done)
+		{
+			SCHED_complete(done, tx_ctx);
+		}
+	}
+}
+
+/*!
+    @brief  Serial port interrupt handler, call from USART2_IRQHandler
+            ahead of HAL_UART_IRQHandler, which then only sees transmit
+            events.
+    @return None (void).
+*/
+void SERIAL_irq_handler(void)
+{
+	USART_TypeDef *uart = SERIAL_UART.Instance;
+	uint32_t isr = uart->ISR;
+	uint16_t next;
+
+	if (isr & USART_ISR_RXNE)
+	{
+		next = (rx_head + 1) & RX_MASK;
+		if (next != rx_tail)
+		{
+			rx_buf[rx_head] = uart->RDR;
+			rx_head = next;
+		}
+		else
+		{
+			(void)uart->RDR;
+			rx_dropped++;
+			TRACE(TRACE_RX_DROP, rx_dropped);
+		}
+	}
+	if (isr & (USART_ISR_ORE | USART_ISR_FE | USART_ISR_NE))
+	{
+		if (isr & USART_ISR_ORE)
+		{
+			rx_dropped++;
+			TRACE(TRACE_RX_DROP, rx_dropped);
+		}
+		uart->ICR = USART_ICR_ORECF | USART_ICR_FECF | USART_ICR_NCF;
+	}
+	if (isr & USART_ISR_IDLE)
+	{
+		uart->ICR = USART_ICR_IDLECF;
+		rx_idle = true;
+	}
+}
@@ -0,0 +1,288 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "SNAPSHOT.h"
+#ifdef USE_HAL_DRIVER
+#include "SERIAL.h"
+#include "SCHED.h"
+#else
+#include <stdio.h>
+#endif
+
+#define SNAPSHOT_BUFFER_SIZE (SSD1306_WIDTH * ((SSD1306_HEIGHT + 7) / 8))
+#define SNAPSHOT_MAX_ROW_BYTES ((((SSD1306_WIDTH > SSD1306_HEIGHT) ? SSD1306_WIDTH : SSD1306_HEIGHT) + 7) / 8)
+
+/* Logical frame size for the current rotation */
+static int16_t SNAPSHOT_width(void)
+{
+	return (SSD1306_get_rotation() & 1) ? SSD1306_HEIGHT : SSD1306_WIDTH;
+}
+
+static int16_t SNAPSHOT_height(void)
+{
+	return (SSD1306_get_rotation() & 1) ? SSD1306_WIDTH : SSD1306_HEIGHT;
+}
+
+static char * SNAPSHOT_itoa(char *p, uint16_t v)
+{
+	char digits[5];
+	uint8_t n = 0;
+
+	do
+	{
+		digits[n++] = '0' + v % 10;
+		v /= 10;
+	} while (v);
+	while (n)
+	{
+		*p++ = digits[--n];
+	}
+	return p;
+}
+
+/*!
+    @brief  Format the snapshot header.
+    @param  format
+            SNAPSHOT_FORMAT_PBM or SNAPSHOT_FORMAT_RAW.
+    @param  out
+            Receives the header, at least 16 bytes, not zero terminated.
+    @return Header length in bytes.
+*/
+uint16_t SNAPSHOT_header(uint8_t format, char *out)
+{
+	char *p = out;
+
+	if (format == SNAPSHOT_FORMAT_RAW)
+	{
+		*p++ = 'F';
+		*p++ = 'B';
+		*p++ = SSD1306_WIDTH;
+		*p++ = SSD1306_HEIGHT;
+	}
+	else
+	{
+		*p++ = 'P';
+		*p++ = '4';
+		*p++ = '\n';
+		p = SNAPSHOT_itoa(p, SNAPSHOT_width());
+		*p++ = ' ';
+		p = SNAPSHOT_itoa(p, SNAPSHOT_height());
+		*p++ = '\n';
+	}
+	return p - out;
+}
+
+/*!
+    @brief  Pack frame rows into PBM raster format.
+    @param  y
+            First row of the frame as drawn, i.e. after rotation.
+    @param  rows
+            Number of rows, clipped to the frame height.
+    @param  out
+            Receives rows * ((width + 7) / 8) bytes, MSB is the leftmost
+            pixel.
+    @return Number of bytes written.
+*/
+uint16_t SNAPSHOT_pack_rows(int16_t y, uint8_t rows, uint8_t *out)
+{
+	int16_t x, w = SNAPSHOT_width(), h = SNAPSHOT_height();
+	uint8_t *p = out;
+
+	for (; rows && y < h; rows--, y++)
+	{
+		memset(p, 0, (w + 7) / 8);
+		for (x = 0; x < w; x++)
+		{
+			if (SSD1306_get_pixel(x, y))
+			{
+				p[x / 8] |= 0x80 >> (x & 7);
+			}
+		}
+		p += (w + 7) / 8;
+	}
+	return p - out;
+}
+
+#ifdef USE_HAL_DRIVER
+
+static char header[16];
+static uint8_t chunk[2][SNAPSHOT_CHUNK_ROWS * SNAPSHOT_MAX_ROW_BYTES];
+static uint16_t chunk_len[2];
+static volatile bool busy;
+static uint8_t sending;		// Format of the snapshot in progress
+static uint8_t next;		// Chunk to send on the next completion
+static int16_t row;			// Next frame row to pack, RAW: 1 once the pages went out
+
+/* Pack the following rows into a chunk, returns false past the last row */
+static bool SNAPSHOT_fill(uint8_t i)
+{
+	if (row >= SNAPSHOT_height())
+	{
+		chunk_len[i] = 0;
+		return false;
+	}
+	chunk_len[i] = SNAPSHOT_pack_rows(row, SNAPSHOT_CHUNK_ROWS, chunk[i]);
+	row += SNAPSHOT_CHUNK_ROWS;
+	return true;
+}
+
+/*
+ * Start the next transfer, the done callback of each one, run from the
+ * main loop. One chunk goes on the wire while the other is packed, so
+ * packing overlaps transmission.
+ */
+static void SNAPSHOT_continue(void *ctx)
+{
+	const uint8_t *data;
+	uint16_t len;
+	uint8_t i = next;
+
+	(void)ctx;
+	if (sending == SNAPSHOT_FORMAT_RAW)
+	{
+		data = SSD1306_get_buffer();
+		len = row ? 0 : SNAPSHOT_BUFFER_SIZE;
+		row = 1;
+	}
+	else
+	{
+		data = chunk[i];
+		len = chunk_len[i];
+	}
+	if ((len == 0) || !SERIAL_write_dma(data, len, SNAPSHOT_continue, NULL))
+	{
+		busy = false;
+		return;
+	}
+	if (sending != SNAPSHOT_FORMAT_RAW)
+	{
+		next ^= 1;
+		SNAPSHOT_fill(next);
+	}
+}
+
+static void SNAPSHOT_request_run(void *ctx)
+{
+	SNAPSHOT_send((uint8_t)(uintptr_t)ctx);
+}
+
+/*!
+    @brief  Start streaming a snapshot over the serial port.
+    @param  format
+            SNAPSHOT_FORMAT_PBM or SNAPSHOT_FORMAT_RAW.
+    @return false if a snapshot or other transfer is still in progress.
+    @note   Thread context only, see SNAPSHOT_request() for interrupt
+            handlers. Returns immediately, the rest of the frame is packed
+            and sent from the scheduler. Drawing during the transfer may
+            show up partially in the snapshot, and anything written with
+            SERIAL_write() meanwhile lands in the middle of it, so hold
+            back serial output while SNAPSHOT_busy().
+*/
+bool SNAPSHOT_send(uint8_t format)
+{
+	uint16_t len;
+
+	if (busy || SERIAL_tx_busy())
+	{
+		return false;
+	}
+
+	busy = true;
+	sending = format;
+	len = SNAPSHOT_header(format, header);
+	row = 0;
+	next = 0;
+	if (format != SNAPSHOT_FORMAT_RAW)
+	{
+		SNAPSHOT_fill(0);
+	}
+	if (!SERIAL_write_dma((uint8_t *)header, len, SNAPSHOT_continue, NULL))
+	{
+		busy = false;
+		return false;
+	}
+	return true;
+}
+
+/*!
+    @brief  Ask for a snapshot from interrupt context.
+    @param  format
+            SNAPSHOT_FORMAT_PBM or SNAPSHOT_FORMAT_RAW.
+    @return false if the scheduler queue is full.
+    @note   The snapshot is started by the main loop, it is dropped there
+            if another one is still in progress.
+*/
+bool SNAPSHOT_request(uint8_t format)
+{
+	return SCHED_post(SNAPSHOT_request_run, (void *)(uintptr_t)format);
+}
+
+/*!
+    @brief  Check for a snapshot in progress.
+    @return true while streaming.
+*/
+bool SNAPSHOT_busy(void)
+{
+	return busy;
+}
+
+#else
+
+/*!
+    @brief  Write a snapshot to a file.
+    @param  path
+            Output file name.
+    @param  format
+            SNAPSHOT_FORMAT_PBM or SNAPSHOT_FORMAT_RAW.
+    @return false if the file could not be written.
+*/
+bool SNAPSHOT_save(const char *path, uint8_t format)
+{
+	char header[16];
+	uint8_t rows[SNAPSHOT_CHUNK_ROWS * SNAPSHOT_MAX_ROW_BYTES];
+	int16_t y;
+	bool ok;
+	FILE *f = fopen(path, "wb");
+
+	if (!f)
+	{
+		return false;
+	}
+
+	ok = fwrite(header, 1, SNAPSHOT_header(format, header), f) > 0;
+	if (format == SNAPSHOT_FORMAT_RAW)
+	{
+		ok = ok && fwrite(SSD1306_get_buffer(), 1, SNAPSHOT_BUFFER_SIZE, f) == SNAPSHOT_BUFFER_SIZE;
+	}
+	else
+	{
+		for (y = 0; ok && y < SNAPSHOT_height(); y += SNAPSHOT_CHUNK_ROWS)
+		{
+			uint16_t len = SNAPSHOT_pack_rows(y, SNAPSHOT_CHUNK_ROWS, rows);
+			ok = fwrite(rows, 1, len, f) == len;
+		}
+	}
+	return (fclose(f) == 0) && ok;
+}
+
+#endif
@@ -59,47 +59,581 @@
  */
 
 #include "SSD1306.h"
-#include "i2c.h"
-#include "gpio.h"
+#include "PROF.h"
+#include "TRACE.h"
+#include "CRC32.h"
+#include "M2M.h"
+#ifdef USE_HAL_DRIVER
+#include "SCHED.h"
+#endif
 
 
 #define ssd1306_swap(a, b)                                                     \
   (((a) ^= (b)), ((b) ^= (a)), ((a) ^= (b))) ///< No-temp-var swap operation
 
+#ifdef USE_HAL_DRIVER
+#define SSD1306_BITBAND_SIZE 0x100000UL	///< SRAM covered by the bit-band alias
+#define SSD1306_BITBAND(p, bit) \
+  ((volatile uint32_t *)(SRAM_BB_BASE + (((uint32_t)(p) - SRAM_BASE) << 5) + ((bit) << 2))) ///< Alias word of a bit
+#endif
+
 static void SSD1306_send_com(uint8_t c);
 static uint8_t platform_write(uint8_t reg, uint8_t *bufp, uint16_t len);
 static uint8_t platform_write_dma(uint8_t reg, uint8_t *bufp, uint16_t len);
+static uint8_t platform_write_chain(uint8_t *cmds, uint16_t cmds_len, uint8_t *bufp, uint16_t len);
+#ifdef USE_HAL_DRIVER
+static void SSD1306_repaint_deferred(SSD1306_panel_t *p);
+
+/* First and last page with a bit set in pages, which must not be 0 */
+static void SSD1306_page_span(uint8_t pages, uint8_t *first, uint8_t *last)
+{
+	*first = 0;
+	while (!(pages & (1 << *first)))
+	{
+		(*first)++;
+	}
+	*last = 7;
+	while (!(pages & (1 << *last)))
+	{
+		(*last)--;
+	}
+}
+#endif
 
 static uint8_t * buffer;
 static uint8_t rotation;
+static uint8_t buffer_rotation;	// Part of the rotation done in software
+static bool mirror_x, mirror_y;
+static int16_t band_top, band_bottom;	// Buffer rows held, display rows unless canvas
+static int16_t buffer_width = SSD1306_WIDTH;	// Buffer columns, page stride
+static bool canvas;		// Buffer holds the unrotated frame, see SSD1306_TRANSPOSE_FLUSH
+static uint8_t page_stripe[2][SSD1306_WIDTH];	// Rotated or composited pages on their way out
+static uint8_t stripe_next;
+static SSD1306_panel_t *stripe_panel;	// Panel the stripes were last sent to
+static SSD1306_panel_t default_panel = {.bus = I2CBUS_BUS1, .address = SSD1306_I2C_ADDRESS};
+static SSD1306_panel_t *panel = &default_panel;	// Target of drawing and transfers
+static volatile uint8_t group_left;	// Panels SSD1306_repaint_all() waits for
+static SSD1306_done_t group_done;
+static void *group_ctx;
+
+/* A panel of the group is done, the last one reports the whole group */
+static void SSD1306_group_leave(void)
+{
+	if (--group_left == 0)
+	{
+		if (group_done)
+		{
+			group_done(group_ctx);
+		}
+	}
+}
+
+/*
+ * Without USE_HAL_DRIVER (host builds) there is no bus, drawing only
+ * updates the RAM buffer.
+ */
+#ifdef USE_HAL_DRIVER
+static bool platform_pending(SSD1306_panel_t *p)
+{
+	return I2CBUS_pending(&p->window_xfer) || I2CBUS_pending(&p->data_xfer);
+}
+
+static SSD1306_panel_t * volatile stranded;	// Panels with pages for SSD1306_poll()
+
+/* The last frame write of a group member is done */
+static void platform_group_check(SSD1306_panel_t *p)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	// The completion interrupt may get here too, count the panel once
+	__disable_irq();
+	if (p->group && !I2CBUS_pending(&p->data_xfer))
+	{
+		p->group = false;
+		SSD1306_group_leave();
+	}
+	__set_PRIMASK(primask);
+}
+
+/*
+ * Transfer complete, from the main loop. Sends the pages repainted while
+ * the frame was in flight, and counts the final frame write of a group.
+ */
+static void platform_done(I2CBUS_xfer_t *xfer, bool ok)
+{
+	SSD1306_panel_t *p = (SSD1306_panel_t *)xfer->ctx;
+	uint32_t primask;
+
+#if SSD1306_SKIP_UNCHANGED
+	if (!ok)
+	{
+		p->crc_lost = true;
+	}
+#else
+	(void)ok;
+#endif
+	if (platform_pending(p))
+	{
+		return;
+	}
+	if ((__get_IPSR() != 0) && p->dirty)
+	{
+		// Run from the interrupt as the scheduler queue was full, the
+		// pages wait for SSD1306_poll() and the group for them
+		primask = __get_PRIMASK();
+		__disable_irq();
+		if (!p->stranded)
+		{
+			p->stranded = true;
+			p->next_stranded = stranded;
+			stranded = p;
+		}
+		__set_PRIMASK(primask);
+		return;
+	}
+	SSD1306_repaint_deferred(p);
+	platform_group_check(p);
+}
+
+/*
+ * Send the pages platform_done() could not, from the main loop. Panels
+ * busy again meanwhile get them with their next completion.
+ */
+static void SSD1306_poll(void)
+{
+	uint32_t primask;
+	SSD1306_panel_t *p;
+
+	while (stranded)
+	{
+		primask = __get_PRIMASK();
+		__disable_irq();
+		p = stranded;
+		stranded = p->next_stranded;
+		p->stranded = false;
+		__set_PRIMASK(primask);
+		if (!platform_pending(p))
+		{
+			SSD1306_repaint_deferred(p);
+			platform_group_check(p);
+		}
+	}
+}
+
+static void platform_init(void)
+{
+	static bool polling;
+
+	if (!polling)
+	{
+		polling = SCHED_add_poll(SSD1306_poll);
+	}
+}
+
+/* Queue a write on the panel's bus, once xfer is free again */
+static void platform_queue(I2CBUS_xfer_t *xfer, uint8_t reg, uint8_t *bufp, uint16_t len)
+{
+	I2CBUS_wait(xfer);
+	xfer->bus = panel->bus;
+	xfer->addr = panel->address;
+	xfer->reg = reg;
+	xfer->reg_size = 1;
+	xfer->read = false;
+	xfer->prio = SSD1306_I2C_PRIO;
+	xfer->data = bufp;
+	xfer->len = len;
+	xfer->chunk = SSD1306_I2C_CHUNK;
+	xfer->done = platform_done;
+	xfer->ctx = panel;
+	I2CBUS_submit(xfer);
+}
+
+/*
+ * Pages held back for the frame in flight, if it still is. Otherwise
+ * they join pages first to last, which go out now.
+ */
+static bool platform_defer(uint8_t *first, uint8_t *last)
+{
+	uint32_t primask = __get_PRIMASK();
+	uint8_t pages = (0xFF << *first) & (0xFF >> (7 - *last));
+	bool busy;
+
+	__disable_irq();
+	busy = platform_pending(panel);
+	if (busy)
+	{
+		panel->dirty |= pages;
+	}
+	else
+	{
+		pages |= panel->dirty;
+		panel->dirty = 0;
+	}
+	__set_PRIMASK(primask);
+	if (!busy)
+	{
+		SSD1306_page_span(pages, first, last);
+	}
+	return busy;
+}
+
+/* Take the pages held back for a panel */
+static uint8_t platform_take_dirty(SSD1306_panel_t *p)
+{
+	uint32_t primask = __get_PRIMASK();
+	uint8_t pages;
+
+	__disable_irq();
+	pages = p->dirty;
+	p->dirty = 0;
+	__set_PRIMASK(primask);
+	return pages;
+}
+
+static void platform_wait_ready(void)
+{
+	// Earlier display transfers may still be queued or on the bus, and
+	// pages held back for them go first
+	I2CBUS_wait(&panel->window_xfer);
+	I2CBUS_wait(&panel->data_xfer);
+	if (panel->dirty)
+	{
+		SSD1306_repaint_deferred(panel);
+		I2CBUS_wait(&panel->window_xfer);
+		I2CBUS_wait(&panel->data_xfer);
+	}
+}
+
+static void platform_wait_data(SSD1306_panel_t *p)
+{
+	I2CBUS_wait(&p->data_xfer);
+}
+
+/*
+ * Join a repaint group, unless the panel's frame has already gone out.
+ * NULL drops the count held while the group is being started.
+ */
+static void platform_group_join(SSD1306_panel_t *p)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	if (p && (I2CBUS_pending(&p->data_xfer) || p->dirty))
+	{
+		p->group = true;
+	}
+	else
+	{
+		SSD1306_group_leave();
+	}
+	__set_PRIMASK(primask);
+}
 
 static uint8_t platform_write(uint8_t reg, uint8_t *bufp, uint16_t len)
 {
-	HAL_I2C_Mem_Write(&SSD1306_I2C_BUS, SSD1306_I2C_ADDRESS, reg, 1, bufp, len, 100);
+	platform_queue(&panel->com_xfer, reg, bufp, len);
+	I2CBUS_wait(&panel->com_xfer);
 	return 0;
 }
 
 static uint8_t platform_write_dma(uint8_t reg, uint8_t *bufp, uint16_t len)
 {
-	HAL_I2C_Mem_Write_DMA(&SSD1306_I2C_BUS, SSD1306_I2C_ADDRESS, reg, 1, bufp, len);
+	platform_queue(&panel->data_xfer, reg, bufp, len);
 	return 0;
 }
 
+/*
+ * Queue a command stream and the data following it. The bus manager
+ * starts each from the completion interrupt of the one before.
+ */
+static uint8_t platform_write_chain(uint8_t *cmds, uint16_t cmds_len, uint8_t *bufp, uint16_t len)
+{
+	platform_queue(&panel->window_xfer, 0x00, cmds, cmds_len);
+	if (len)
+	{
+		platform_queue(&panel->data_xfer, SSD1306_SETSTARTLINE, bufp, len);
+	}
+	return 0;
+}
+#else
+static void platform_init(void)
+{
+}
+
+static bool platform_defer(uint8_t *first, uint8_t *last)
+{
+	(void)first;
+	(void)last;
+	return false;
+}
+
+static void platform_wait_ready(void)
+{
+}
+
+static void platform_wait_data(SSD1306_panel_t *p)
+{
+	(void)p;
+}
+
+static void platform_group_join(SSD1306_panel_t *p)
+{
+	(void)p;
+	SSD1306_group_leave();
+}
+
+static SSD1306_host_write_t host_write;
+
+static uint8_t platform_write(uint8_t reg, uint8_t *bufp, uint16_t len)
+{
+	if (host_write)
+	{
+		host_write(reg, bufp, len);
+	}
+	return 0;
+}
+
+static uint8_t platform_write_dma(uint8_t reg, uint8_t *bufp, uint16_t len)
+{
+	return platform_write(reg, bufp, len);
+}
+
+static uint8_t platform_write_chain(uint8_t *cmds, uint16_t cmds_len, uint8_t *bufp, uint16_t len)
+{
+	platform_write(0x00, cmds, cmds_len);
+	return len ? platform_write(SSD1306_SETSTARTLINE, bufp, len) : 0;
+}
+#endif
+
 static void SSD1306_send_com(uint8_t c)
 {
+	TRACE(TRACE_COMMAND, c);
 	platform_write(0x00, &c, 1);
 }
 
+/*
+ * Set the address window for pages first to last and columns left to
+ * right, then send len bytes of data into it, both without blocking.
+ */
+static void SSD1306_send_rect(uint8_t first, uint8_t last, uint8_t left, uint8_t right, uint8_t *data, uint16_t len)
+{
+	uint8_t *window = panel->window;
+
+	// Wait before refilling, a previous window may still be in flight
+	platform_wait_ready();
+	window[0] = SSD1306_PAGEADDR;
+	window[1] = first;
+	window[2] = last;
+	window[3] = SSD1306_COLUMNADDR;
+	window[4] = left;
+	window[5] = right;
+	TRACE(TRACE_COMMAND, SSD1306_PAGEADDR);
+	platform_write_chain(window, sizeof(panel->window), data, len);
+}
+
+/* Address window for pages first to last and all columns */
+static void SSD1306_send_window(uint8_t first, uint8_t last, uint8_t *data, uint16_t len)
+{
+	SSD1306_send_rect(first, last, 0, SSD1306_WIDTH - 1, data, len);
+}
+
+/*
+ * Take the next page stripe to fill. Within a panel, the write queued
+ * since its last use has waited for it. The stripes are shared, so a
+ * switch of panel waits for the other panel's last one.
+ */
+static uint8_t * SSD1306_next_stripe(void)
+{
+	uint8_t *out = page_stripe[stripe_next];
+
+	if (stripe_panel != panel)
+	{
+		if (stripe_panel)
+		{
+			platform_wait_data(stripe_panel);
+		}
+		stripe_panel = panel;
+	}
+	stripe_next ^= 1;
+	return out;
+}
+
+/* Check that a rectangle of whole pages lies on the display */
+static bool SSD1306_rect_fits(uint8_t x, uint8_t page, uint8_t w, uint8_t pages)
+{
+	return w && pages && ((x + w) <= SSD1306_WIDTH) && ((page + pages) <= ((SSD1306_HEIGHT + 7) / 8));
+}
+
+/*
+ * Choose the buffer layout. The canvas holds the frame unrotated,
+ * SSD1306_HEIGHT columns of SSD1306_WIDTH rows for rotation 1 and 3, and
+ * the flush rotates it. Otherwise the buffer is in display RAM layout.
+ */
+static void SSD1306_set_canvas(bool on)
+{
+#if SSD1306_SKIP_UNCHANGED
+	if (on != canvas)
+	{
+		// The hashes are of the other layout
+		panel->crc_valid = 0;
+	}
+#endif
+	canvas = on;
+	buffer_width = on ? SSD1306_HEIGHT : SSD1306_WIDTH;
+#if SSD1306_HW_ROTATION
+	buffer_rotation = (on || (rotation == 2)) ? 0 : rotation;
+#else
+	buffer_rotation = on ? 0 : rotation;
+#endif
+	band_top = 0;
+	band_bottom = buffer ? (on ? SSD1306_WIDTH : SSD1306_HEIGHT) : 0;
+}
+
+/*
+ * Narrow the pages first to last about to be sent down to those that
+ * changed since they were last sent, true if none did. A canvas is
+ * either sent whole or skipped.
+ */
+static bool SSD1306_skip_unchanged(uint8_t *first, uint8_t *last)
+{
+#if SSD1306_SKIP_UNCHANGED
+	uint8_t page, asked, changed = 0;
+	uint32_t crc;
+
+	if (panel->crc_lost)
+	{
+		panel->crc_lost = false;
+		panel->crc_valid = 0;
+	}
+	if (canvas)
+	{
+		crc = CRC32_compute(buffer, SSD1306_WIDTH * ((SSD1306_HEIGHT + 7) / 8));
+		if ((panel->crc_valid & 1) && (panel->page_crc[0] == crc))
+		{
+			TRACE(TRACE_REPAINT_SKIP, 0xFF);
+			return true;
+		}
+		panel->page_crc[0] = crc;
+		panel->crc_valid = 1;
+		return false;
+	}
+
+	for (page = *first; page <= *last; page++)
+	{
+		crc = CRC32_compute(&buffer[page * SSD1306_WIDTH], SSD1306_WIDTH);
+		if (!(panel->crc_valid & (1 << page)) || (panel->page_crc[page] != crc))
+		{
+			panel->page_crc[page] = crc;
+			changed |= 1 << page;
+		}
+	}
+	asked = ((2U << *last) - 1) & ~((1U << *first) - 1);
+	if (asked & ~changed)
+	{
+		TRACE(TRACE_REPAINT_SKIP, asked & ~changed);
+	}
+	if (!changed)
+	{
+		return true;
+	}
+	panel->crc_valid |= changed;
+	// Unchanged pages in between go along, one window is cheaper than several
+	while (!(changed & (1 << *first)))
+	{
+		(*first)++;
+	}
+	while (!(changed & (1 << *last)))
+	{
+		(*last)--;
+	}
+	return false;
+#else
+	(void)first;
+	(void)last;
+	return false;
+#endif
+}
+
+#if SSD1306_TRANSPOSE_FLUSH
+/*
+ * Transpose an 8x8 bit block, out[k] bit b = in[b] bit k. Rows are read
+ * and written step bytes apart, a negative step runs backwards. Two
+ * rounds of delta swaps on 32 bit halves, then one across them.
+ */
+static void SSD1306_transpose8(const uint8_t *in, int8_t in_step, uint8_t *out, int8_t out_step)
+{
+	uint32_t lo, hi, t;
+
+	lo = in[0] | (in[in_step] << 8) | (in[2 * in_step] << 16) | ((uint32_t)in[3 * in_step] << 24);
+	in += 4 * in_step;
+	hi = in[0] | (in[in_step] << 8) | (in[2 * in_step] << 16) | ((uint32_t)in[3 * in_step] << 24);
+
+	t = (lo ^ (lo >> 7)) & 0x00AA00AA;
+	lo ^= t ^ (t << 7);
+	t = (hi ^ (hi >> 7)) & 0x00AA00AA;
+	hi ^= t ^ (t << 7);
+	t = (lo ^ (lo >> 14)) & 0x0000CCCC;
+	lo ^= t ^ (t << 14);
+	t = (hi ^ (hi >> 14)) & 0x0000CCCC;
+	hi ^= t ^ (t << 14);
+	t = (lo ^ (hi << 4)) & 0xF0F0F0F0;
+	lo ^= t;
+	hi ^= t >> 4;
+
+	out[0] = lo;
+	out[out_step] = lo >> 8;
+	out[2 * out_step] = lo >> 16;
+	out[3 * out_step] = lo >> 24;
+	out += 4 * out_step;
+	out[0] = hi;
+	out[out_step] = hi >> 8;
+	out[2 * out_step] = hi >> 16;
+	out[3 * out_step] = hi >> 24;
+}
+
+/*
+ * Rotate one display page out of the canvas and send it. The stripes
+ * alternate, so the next page is transposed while this one is on the bus.
+ */
+static void SSD1306_flush_page(uint8_t page)
+{
+	uint8_t *out = SSD1306_next_stripe(), j;
+
+	for (j = 0; j < SSD1306_WIDTH / 8; j++)
+	{
+		if (rotation == 1)
+		{
+			// Display column c shows canvas row SSD1306_WIDTH - 1 - c
+			SSD1306_transpose8(&buffer[page * 8 + (SSD1306_WIDTH / 8 - 1 - j) * SSD1306_HEIGHT], 1, &out[j * 8 + 7], -1);
+		}
+		else
+		{
+			// Display row r shows canvas column SSD1306_HEIGHT - 1 - r
+			SSD1306_transpose8(&buffer[(SSD1306_HEIGHT - 1 - page * 8) + j * SSD1306_HEIGHT], -1, &out[j * 8], 1);
+		}
+	}
+	platform_write_dma(SSD1306_SETSTARTLINE, out, SSD1306_WIDTH);
+}
+#endif
+
 bool SSD1306_init(void)
 {
   uint8_t comPins = 0x02, contrast = 0x8F, vccstate = SSD1306_SWITCHCAPVCC;
 
-  if ((!buffer) && !(buffer = (uint8_t *)malloc(SSD1306_WIDTH * ((SSD1306_HEIGHT + 7) / 8))))
+#if SSD1306_FRAME_BUFFER
+  if ((!panel->buffer) && !(panel->buffer = (uint8_t *)malloc(SSD1306_WIDTH * ((SSD1306_HEIGHT + 7) / 8))))
   {
     return false;
   }
-
+  buffer = panel->buffer;
+  SSD1306_set_canvas(canvas);
   SSD1306_display_clear();
+#endif
+#if SSD1306_SKIP_UNCHANGED
+  CRC32_init();
+#endif
+  SSD1306_invalidate();
+  platform_init();
 
   // Init sequence
   SSD1306_send_com(SSD1306_DISPLAYOFF);
@@ -158,6 +692,37 @@ bool SSD1306_init(void)
 
 // DRAWING FUNCTIONS -------------------------------------------------------
 
+/*
+ * Rotate a pixel and clip it to the buffer. Returns its byte and bit
+ * number, NULL outside the buffer.
+ */
+static uint8_t * SSD1306_pixel_byte(int16_t x, int16_t y, uint8_t *bit)
+{
+	switch (buffer_rotation)
+	{
+		case 1:
+			ssd1306_swap(x, y);
+			x = SSD1306_WIDTH - x - 1;
+			break;
+		case 2:
+			x = SSD1306_WIDTH - x - 1;
+			y = SSD1306_HEIGHT - y - 1;
+			break;
+		case 3:
+			ssd1306_swap(x, y);
+			y = SSD1306_HEIGHT - y - 1;
+			break;
+	}
+
+	if ((x >= 0) && (x < buffer_width) && (y >= band_top) && (y < band_bottom))
+	{
+		y -= band_top;
+		*bit = y & 7;
+		return &buffer[x + (y / 8) * buffer_width];
+	}
+	return NULL;
+}
+
 /*!
     @brief  Set/clear/invert a single pixel. This is also invoked by the
             Adafruit_GFX library in generating many higher-level graphics
@@ -175,35 +740,37 @@ bool SSD1306_init(void)
 */
 void SSD1306_draw_pixel(int16_t x, int16_t y, uint16_t color)
 {
-	if ((x >= 0) && (x < SSD1306_WIDTH) && (y >= 0) && (y < SSD1306_HEIGHT))
+	/* Rotate coordinates if needed, then clip to the buffer. */
+	switch (buffer_rotation)
 	{
-		/* Pixel is in-bounds. Rotate coordinates if needed. */
-		switch (SSD1306_get_rotation())
-		{
-			case 1:
-				ssd1306_swap(x, y);
-				x = SSD1306_WIDTH - x - 1;
-				break;
-			case 2:
-				x = SSD1306_WIDTH - x - 1;
-				y = SSD1306_HEIGHT - y - 1;
-				break;
-			case 3:
-				ssd1306_swap(x, y);
-				y = SSD1306_HEIGHT - y - 1;
-				break;
-		}
+		case 1:
+			ssd1306_swap(x, y);
+			x = SSD1306_WIDTH - x - 1;
+			break;
+		case 2:
+			x = SSD1306_WIDTH - x - 1;
+			y = SSD1306_HEIGHT - y - 1;
+			break;
+		case 3:
+			ssd1306_swap(x, y);
+			y = SSD1306_HEIGHT - y - 1;
+			break;
+	}
+
+	if ((x >= 0) && (x < buffer_width) && (y >= band_top) && (y < band_bottom))
+	{
+		y -= band_top;
 
 		switch (color)
 		{
 			case SSD1306_WHITE:
-				buffer[x + (y / 8) * SSD1306_WIDTH] |= (1 << (y & 7));
+				buffer[x + (y / 8) * buffer_width] |= (1 << (y & 7));
 				break;
 			case SSD1306_BLACK:
-				buffer[x + (y / 8) * SSD1306_WIDTH] &= ~(1 << (y & 7));
+				buffer[x + (y / 8) * buffer_width] &= ~(1 << (y & 7));
 				break;
 			case SSD1306_INVERSE:
-				buffer[x + (y / 8) * SSD1306_WIDTH] ^= (1 << (y & 7));
+				buffer[x + (y / 8) * buffer_width] ^= (1 << (y & 7));
 				break;
 		}
 	}
@@ -218,7 +785,9 @@ void SSD1306_draw_pixel(int16_t x, int16_t y, uint16_t color)
 */
 void SSD1306_display_clear(void)
 {
-	memset(buffer, 0, SSD1306_WIDTH * ((SSD1306_HEIGHT + 7) / 8));
+	PROF_BEGIN(PROF_CLEAR);
+	memset(buffer, 0, buffer_width * ((band_bottom - band_top + 7) / 8));
+	PROF_END(PROF_CLEAR);
 }
 
 /*!
@@ -241,7 +810,8 @@ void SSD1306_draw_fast_hline(int16_t x, int16_t y, int16_t w, uint16_t color)
 {
 	bool bSwap = false;
 
-	switch (SSD1306_get_rotation())
+	PROF_BEGIN(PROF_HLINE);
+	switch (buffer_rotation)
 	{
 		case 1:
 			// 90 degree rotation, swap x & y for rotation, then invert x
@@ -273,11 +843,12 @@ void SSD1306_draw_fast_hline(int16_t x, int16_t y, int16_t w, uint16_t color)
 	{
 		SSD1306_draw_fast_hline_internal(x, y, w, color);
 	}
+	PROF_END(PROF_HLINE);
 }
 
 void SSD1306_draw_fast_hline_internal(int16_t x, int16_t y, int16_t w, uint16_t color)
 {
-	if ((y >= 0) && (y < SSD1306_HEIGHT))
+	if ((y >= band_top) && (y < band_bottom))
 	{
 		// Y coord in bounds?
 		if (x < 0)
@@ -286,15 +857,15 @@ void SSD1306_draw_fast_hline_internal(int16_t x, int16_t y, int16_t w, uint16_t
 			w += x;
 			x = 0;
 		}
-		if ((x + w) > SSD1306_WIDTH)
+		if ((x + w) > buffer_width)
 		{
 			// Clip right
-			w = (SSD1306_WIDTH - x);
+			w = (buffer_width - x);
 		}
 		if (w > 0)
 		{
 			// Proceed only if width is positive
-			uint8_t *pBuf = &buffer[(y / 8) * SSD1306_WIDTH + x], mask = 1 << (y & 7);
+			uint8_t *pBuf = &buffer[((y - band_top) / 8) * buffer_width + x], mask = 1 << (y & 7);
 			switch (color)
 			{
 				case SSD1306_WHITE:
@@ -340,7 +911,9 @@ void SSD1306_draw_fast_hline_internal(int16_t x, int16_t y, int16_t w, uint16_t
 void SSD1306_draw_fast_vline(int16_t x, int16_t y, int16_t h, uint16_t color)
 {
 	bool bSwap = false;
-	switch (SSD1306_get_rotation())
+
+	PROF_BEGIN(PROF_VLINE);
+	switch (buffer_rotation)
 	{
 		case 1:
 			// 90 degree rotation, swap x & y for rotation,
@@ -372,31 +945,32 @@ void SSD1306_draw_fast_vline(int16_t x, int16_t y, int16_t h, uint16_t color)
 	{
 		SSD1306_draw_fast_vline_internal(x, y, h, color);
 	}
+	PROF_END(PROF_VLINE);
 }
 
 void SSD1306_draw_fast_vline_internal(int16_t x, int16_t __y, int16_t __h, uint16_t color)
 {
-	if ((x >= 0) && (x < SSD1306_WIDTH))
+	if ((x >= 0) && (x < buffer_width))
 	{
 		// X coord in bounds?
-		if (__y < 0)
+		if (__y < band_top)
 		{
 			// Clip top
-			__h += __y;
-			__y = 0;
+			__h -= band_top - __y;
+			__y = band_top;
 		}
-		if ((__y + __h) > SSD1306_HEIGHT)
+		if ((__y + __h) > band_bottom)
 		{
 			// Clip bottom
-			__h = (SSD1306_HEIGHT - __y);
+			__h = (band_bottom - __y);
 		}
 		if (__h > 0)
 		{
 			// Proceed only if height is now positive
 			// this display doesn't need ints for coordinates,
 			// use local byte registers for faster juggling
-			uint8_t y = __y, h = __h;
-			uint8_t *pBuf = &buffer[(y / 8) * SSD1306_WIDTH + x];
+			uint8_t y = __y - band_top, h = __h;
+			uint8_t *pBuf = &buffer[(y / 8) * buffer_width + x];
 
 			// do the first partial byte, if necessary - this requires some masking
 			uint8_t mod = (y & 7);
@@ -427,7 +1001,7 @@ void SSD1306_draw_fast_vline_internal(int16_t x, int16_t __y, int16_t __h, uint1
 						*pBuf ^= mask;
 						break;
 				}
-				pBuf += SSD1306_WIDTH;
+				pBuf += buffer_width;
 			}
 
 			if (h >= mod)
@@ -444,7 +1018,7 @@ void SSD1306_draw_fast_vline_internal(int16_t x, int16_t __y, int16_t __h, uint1
 						do
 						{
 							*pBuf ^= 0xFF; // Invert byte
-							pBuf += SSD1306_WIDTH; // Advance pointer 8 rows
+							pBuf += buffer_width; // Advance pointer 8 rows
 							h -= 8;        // Subtract 8 rows from height
 						} while (h >= 8);
 					}
@@ -455,7 +1029,7 @@ void SSD1306_draw_fast_vline_internal(int16_t x, int16_t __y, int16_t __h, uint1
 						do
 						{
 							*pBuf = val;   // Set byte
-							pBuf += SSD1306_WIDTH; // Advance pointer 8 rows
+							pBuf += buffer_width; // Advance pointer 8 rows
 							h -= 8;        // Subtract 8 rows from height
 						} while (h >= 8);
 					}
@@ -504,28 +1078,80 @@ void SSD1306_draw_fast_vline_internal(int16_t x, int16_t __y, int16_t __h, uint1
 */
 bool SSD1306_get_pixel(int16_t x, int16_t y)
 {
-    if ((x >= 0) && (x < SSD1306_WIDTH) && (y >= 0) && (y < SSD1306_HEIGHT))
-    {
-    	// Pixel is in-bounds. Rotate coordinates if needed.
-    	switch (SSD1306_get_rotation())
-    	{
-    		case 1:
-    			ssd1306_swap(x, y);
-    			x = SSD1306_WIDTH - x - 1;
-    			break;
-    		case 2:
-    			x = SSD1306_WIDTH - x - 1;
-    			y = SSD1306_HEIGHT - y - 1;
-    			break;
-    		case 3:
-    			ssd1306_swap(x, y);
-    			y = SSD1306_HEIGHT - y - 1;
-    			break;
-    	}
-
-    	return (buffer[x + (y / 8) * SSD1306_WIDTH] & (1 << (y & 7)));
-    }
-    return false; // Pixel out of bounds
+    uint8_t bit, *p = SSD1306_pixel_byte(x, y, &bit);
+
+    return p && (*p & (1 << bit)); // false out of bounds
+}
+
+/*!
+    @brief  Set, clear or invert a single pixel with one atomic memory
+            operation, for drawing from interrupt handlers without
+            disabling interrupts.
+    @param  x
+            Column of display -- 0 at left to (screen width - 1) at right.
+    @param  y
+            Row of display -- 0 at top to (screen height -1) at bottom.
+    @param  color
+            Pixel color, one of: SSD1306_BLACK, SSD1306_WHITE or SSD1306_INVERT.
+    @return None (void).
+    @note   SSD1306_WHITE and SSD1306_BLACK are a single store to the
+            pixel's word in the SRAM bit-band alias. SSD1306_INVERSE, and
+            buffers outside the bit-band region, retry an exclusive byte
+            load and store instead. Only the other atomic calls are safe
+            against this one, SSD1306_draw_pixel() and the GFX functions
+            rewrite whole bytes and can undo a pixel set meanwhile in the
+            same byte. Keep interrupt drawn indicators in pages or columns
+            the main loop leaves alone.
+*/
+void SSD1306_draw_pixel_atomic(int16_t x, int16_t y, uint16_t color)
+{
+	uint8_t bit, *p = SSD1306_pixel_byte(x, y, &bit), v;
+
+	if (!p || (color > SSD1306_INVERSE))
+	{
+		return;
+	}
+
+#ifdef USE_HAL_DRIVER
+	if ((color != SSD1306_INVERSE) && (((uint32_t)p - SRAM_BASE) < SSD1306_BITBAND_SIZE))
+	{
+		*SSD1306_BITBAND(p, bit) = (color == SSD1306_WHITE);
+		return;
+	}
+	do
+	{
+		v = __LDREXB(p);
+		v = (color == SSD1306_WHITE) ? v | (1 << bit) : (color == SSD1306_BLACK) ? v & ~(1 << bit) : v ^ (1 << bit);
+	} while (__STREXB(v, p));
+#else
+	v = *p;
+	*p = (color == SSD1306_WHITE) ? v | (1 << bit) : (color == SSD1306_BLACK) ? v & ~(1 << bit) : v ^ (1 << bit);
+#endif
+}
+
+/*!
+    @brief  Read a single pixel through the SRAM bit-band alias.
+    @param  x
+            Column of display -- 0 at left to (screen width - 1) at right.
+    @param  y
+            Row of display -- 0 at top to (screen height -1) at bottom.
+    @return true if pixel is set, as SSD1306_get_pixel().
+*/
+bool SSD1306_get_pixel_atomic(int16_t x, int16_t y)
+{
+	uint8_t bit, *p = SSD1306_pixel_byte(x, y, &bit);
+
+	if (!p)
+	{
+		return false;
+	}
+#ifdef USE_HAL_DRIVER
+	if (((uint32_t)p - SRAM_BASE) < SSD1306_BITBAND_SIZE)
+	{
+		return *SSD1306_BITBAND(p, bit);
+	}
+#endif
+	return (*p >> bit) & 1;
 }
 
 /*!
@@ -538,26 +1164,480 @@ uint8_t* SSD1306_get_buffer(void)
 	return buffer;
 }
 
+/*!
+    @brief  Fill the buffer with a byte pattern by DMA, in the background.
+    @param  pattern
+            Byte for every column of every page, 0x00 clears, 0xFF lights
+            all pixels.
+    @param  done
+            Called from the interrupt once the buffer is filled, may be
+            NULL.
+    @param  ctx
+            Passed to done.
+    @return None (void).
+    @note   Drawing or repainting before done sees a partly filled buffer,
+            see M2M_busy(). The pattern is in buffer layout.
+*/
+void SSD1306_clear_async(uint8_t pattern, SSD1306_done_t done, void *ctx)
+{
+	M2M_fill(buffer, pattern, buffer ? SSD1306_WIDTH * ((SSD1306_HEIGHT + 7) / 8) : 0, done, ctx);
+}
+
+/*!
+    @brief  Copy a whole frame buffer by DMA, in the background.
+    @param  dst
+            Buffer to copy to, e.g. another panel's or a backup.
+    @param  src
+            Buffer to copy from.
+    @param  done
+            Called from the main loop once copied, may be NULL.
+    @param  ctx
+            Passed to done.
+    @return None (void).
+*/
+void SSD1306_copy_buffer(uint8_t *dst, const uint8_t *src, SSD1306_done_t done, void *ctx)
+{
+	M2M_copy(dst, src, SSD1306_WIDTH * ((SSD1306_HEIGHT + 7) / 8), done, ctx);
+}
+
+/* Check a rectangle of whole pages against the buffer layout */
+static bool SSD1306_buffer_rect_fits(int16_t x, uint8_t page, uint8_t w, uint8_t pages)
+{
+	return buffer && w && pages && (x >= 0) && ((x + w) <= buffer_width)
+			&& ((page + pages) * buffer_width <= SSD1306_WIDTH * ((SSD1306_HEIGHT + 7) / 8));
+}
+
+/*!
+    @brief  Save the part of the buffer under a rectangle by DMA, e.g.
+            before drawing a cursor or popup over it.
+    @param  save
+            Receives w * pages bytes.
+    @param  x
+            First buffer column.
+    @param  page
+            First buffer page (8 rows).
+    @param  w
+            Columns.
+    @param  pages
+            Pages.
+    @param  done
+            Called from the main loop once saved, may be NULL.
+    @param  ctx
+            Passed to done.
+    @return false if the rectangle does not fit the buffer.
+    @note   Columns and pages are in buffer layout, see
+            SSD1306_get_buffer_width(). Each page is a DMA transfer of
+            its own.
+*/
+bool SSD1306_save_rect(uint8_t *save, int16_t x, uint8_t page, uint8_t w, uint8_t pages, SSD1306_done_t done, void *ctx)
+{
+	if (!SSD1306_buffer_rect_fits(x, page, w, pages))
+	{
+		return false;
+	}
+	M2M_copy_rect(save, w, &buffer[x + page * buffer_width], buffer_width, w, pages, done, ctx);
+	return true;
+}
+
+/*!
+    @brief  Put a rectangle saved by SSD1306_save_rect() back by DMA.
+    @param  save
+            w * pages bytes as saved.
+    @param  x
+            First buffer column.
+    @param  page
+            First buffer page (8 rows).
+    @param  w
+            Columns.
+    @param  pages
+            Pages.
+    @param  done
+            Called from the main loop once restored, may be NULL.
+    @param  ctx
+            Passed to done.
+    @return false if the rectangle does not fit the buffer.
+*/
+bool SSD1306_restore_rect(const uint8_t *save, int16_t x, uint8_t page, uint8_t w, uint8_t pages, SSD1306_done_t done, void *ctx)
+{
+	if (!SSD1306_buffer_rect_fits(x, page, w, pages))
+	{
+		return false;
+	}
+	M2M_copy_rect(&buffer[x + page * buffer_width], buffer_width, save, w, w, pages, done, ctx);
+	return true;
+}
+
+/*!
+    @brief  Get the display rows held by the buffer, all of them unless a
+            banded render is in progress.
+    @param  top
+            Receives the first row, a multiple of 8.
+    @param  bottom
+            Receives the row after the last one.
+    @return None (void).
+    @note   Rows are in display RAM order, before rotation, or canvas rows
+            with SSD1306_TRANSPOSE_FLUSH. The buffer starts at page top / 8.
+*/
+void SSD1306_get_band(int16_t *top, int16_t *bottom)
+{
+	*top = band_top;
+	*bottom = band_bottom;
+}
+
+/* Send pages first to last of the selected panel, those that changed */
+static void SSD1306_repaint_pages(uint8_t first, uint8_t last)
+{
+	if (SSD1306_skip_unchanged(&first, &last))
+	{
+		return;
+	}
+#if SSD1306_TRANSPOSE_FLUSH
+	if (canvas)
+	{
+		uint8_t page;
+
+		// Pages follow each other in the address window
+		SSD1306_send_window(first, last, NULL, 0);
+		for (page = first; page <= last; page++)
+		{
+			SSD1306_flush_page(page);
+		}
+		return;
+	}
+#endif
+	SSD1306_send_window(first, last, &buffer[first * SSD1306_WIDTH], (last - first + 1) * SSD1306_WIDTH);
+}
+
+#ifdef USE_HAL_DRIVER
+/* Send the pages a panel held back while its last frame was in flight */
+static void SSD1306_repaint_deferred(SSD1306_panel_t *p)
+{
+	SSD1306_panel_t *selected = panel;
+	uint8_t pages = platform_take_dirty(p), first, last;
+
+	if (!pages || !p->buffer)
+	{
+		return;
+	}
+
+	SSD1306_page_span(pages, &first, &last);
+	if (p != selected)
+	{
+		SSD1306_select_panel(p);
+	}
+	PROF_BEGIN(PROF_REPAINT);
+	SSD1306_repaint_pages(first, last);
+	PROF_END(PROF_REPAINT);
+	if (p != selected)
+	{
+		SSD1306_select_panel(selected);
+	}
+}
+#endif
+
 /*!
     @brief  Push data currently in RAM to SSD1306 display.
     @return None (void).
     @note   Drawing operations are not visible until this function is
             called. Call after each graphics command, or after a whole set
             of graphics commands, as best needed by one's own application.
+            The address window and the frame go out by DMA, chained from
+            the transfer complete interrupt. While an earlier frame is
+            still in flight, the repaint is held back instead of waiting
+            and goes out from the main loop once that frame is done,
+            together with any other pages repainted meanwhile. The buffer
+            is read only then, drawing done before SSD1306_display_busy()
+            turns false may still make it into the frame.
 */
 void SSD1306_display_repaint(void)
 {
-	uint16_t buf_len = SSD1306_WIDTH * ((SSD1306_HEIGHT + 7) / 8);
+	uint8_t first = 0, last = (SSD1306_HEIGHT + 7) / 8 - 1;
 
-	SSD1306_send_com(SSD1306_PAGEADDR);
-	SSD1306_send_com(0x00);
-	SSD1306_send_com(0xFF);
-	SSD1306_send_com(SSD1306_COLUMNADDR);
-	SSD1306_send_com(0x00);
+	if (!buffer)
+	{
+		return;
+	}
+
+	PROF_BEGIN(PROF_REPAINT);
+	TRACE(TRACE_REPAINT, 0xFFFF);
+	if (canvas || !platform_defer(&first, &last))
+	{
+		SSD1306_repaint_pages(first, last);
+	}
+	PROF_END(PROF_REPAINT);
+}
+
+/*!
+    @brief  Push a single page (8 rows) of the RAM buffer to the display.
+    @param  page
+            Page index, 0 to (screen height / 8) - 1, in buffer order, in
+            display RAM order when the buffer is a canvas.
+    @return None (void).
+    @note   Costs one page of data plus the address window instead of a
+            full frame, useful when only a text line has changed. Held
+            back like SSD1306_display_repaint() while a frame is in
+            flight, pages repainted meanwhile then go out in one window.
+*/
+void SSD1306_display_repaint_page(uint8_t page)
+{
+	uint8_t last = page;
+
+	if (!buffer || (page >= ((SSD1306_HEIGHT + 7) / 8)))
+	{
+		return;
+	}
+
+	PROF_BEGIN(PROF_REPAINT_PAGE);
+	TRACE(TRACE_REPAINT, page);
+#if SSD1306_TRANSPOSE_FLUSH
+	if (canvas)
+	{
+		// Only part of the canvas goes out, the frame hash no longer holds
+		SSD1306_invalidate();
+		SSD1306_send_window(page, page, NULL, 0);
+		SSD1306_flush_page(page);
+		PROF_END(PROF_REPAINT_PAGE);
+		return;
+	}
+#endif
+	if (!platform_defer(&page, &last))
+	{
+		SSD1306_repaint_pages(page, last);
+	}
+	PROF_END(PROF_REPAINT_PAGE);
+}
+
+/*!
+    @brief  Forget what the selected panel shows, so the next repaint sends
+            every page.
+    @return None (void).
+    @note   Only needed with SSD1306_SKIP_UNCHANGED, after the display RAM
+            was written other than by repainting the buffer.
+*/
+void SSD1306_invalidate(void)
+{
+#if SSD1306_SKIP_UNCHANGED
+	panel->crc_valid = 0;
+#endif
+}
+
+/*!
+    @brief  Render and send a frame band by band through a small stripe
+            buffer instead of the frame buffer.
+    @param  draw
+            Draws the whole scene, called once per band with drawing
+            clipped to the band.
+    @param  ctx
+            Passed to draw.
+    @param  stripes
+            band_pages * SSD1306_WIDTH bytes, twice that for ping_pong.
+    @param  band_pages
+            Pages (8 rows) per band, must divide the display height.
+    @param  ping_pong
+            Draw each band into the other stripe while the previous band
+            is still being sent.
+    @return false if band_pages does not fit the display.
+    @note   The last band may still be in flight on return, keep the
+            stripes untouched while SSD1306_display_busy(). The frame
+            buffer, if any, is left as it was.
+*/
+bool SSD1306_render_banded(SSD1306_draw_t draw, void *ctx, uint8_t *stripes, uint8_t band_pages, bool ping_pong)
+{
+	uint8_t pages = (SSD1306_HEIGHT + 7) / 8, page;
+	uint8_t *frame = buffer, *stripe = stripes;
+	uint16_t len = band_pages * SSD1306_WIDTH;
+	bool was_canvas = canvas;
+
+	if (!band_pages || (pages % band_pages))
+	{
+		return false;
+	}
+
+	// Stripes are in display RAM layout, draw into them with rotation
+	SSD1306_set_canvas(false);
+	// The bands replace the frame on the panel
+	SSD1306_invalidate();
+
+	PROF_BEGIN(PROF_REPAINT);
+	TRACE(TRACE_REPAINT, 0xFFFF);
+	// One address window for the frame, the bands follow each other in it
+	SSD1306_send_window(0, pages - 1, NULL, 0);
+
+	for (page = 0; page < pages; page += band_pages)
+	{
+		if (!ping_pong)
+		{
+			// The only stripe may still be on its way to the display
+			SSD1306_display_wait();
+		}
+		buffer = stripe;
+		band_top = page * 8;
+		band_bottom = band_top + band_pages * 8;
+		SSD1306_display_clear();
+		draw(ctx);
+		platform_write_dma(SSD1306_SETSTARTLINE, stripe, len);
+		if (ping_pong)
+		{
+			stripe = (stripe == stripes) ? stripes + len : stripes;
+		}
+	}
+
+	buffer = frame;
+	SSD1306_set_canvas(was_canvas);
+	PROF_END(PROF_REPAINT);
+	return true;
+}
 
-	SSD1306_send_com(SSD1306_WIDTH - 1); // Column end address
+/*!
+    @brief  Send an image straight to a rectangle of the display, without
+            going through the frame buffer.
+    @param  image
+            w * pages bytes in display RAM layout, a byte per column and
+            page, pages one after the other. Usually a const array in
+            flash, DMA reads it from there.
+    @param  x
+            First column.
+    @param  page
+            First page (8 rows).
+    @param  w
+            Columns.
+    @param  pages
+            Pages.
+    @return false if the rectangle does not fit the display.
+    @note   The image is not rotated, it shows as a raw frame buffer
+            would. Keep it unchanged while SSD1306_display_busy(). The
+            frame buffer is left as it was, the next repaint overwrites
+            the image.
+*/
+bool SSD1306_display_image(const uint8_t *image, uint8_t x, uint8_t page, uint8_t w, uint8_t pages)
+{
+	if (!SSD1306_rect_fits(x, page, w, pages))
+	{
+		return false;
+	}
+
+	// Pages held back for the panel go out first, not over the image
+	platform_wait_ready();
+	PROF_BEGIN(PROF_REPAINT);
+	TRACE(TRACE_REPAINT, ((w == SSD1306_WIDTH) && (pages == (SSD1306_HEIGHT + 7) / 8)) ? 0xFFFF : page);
+	SSD1306_invalidate();
+	SSD1306_send_rect(page, page + pages - 1, x, x + w - 1, (uint8_t *)image, w * pages);
+	PROF_END(PROF_REPAINT);
+	return true;
+}
+
+/*!
+    @brief  Send a full screen image with a small overlay merged in on the
+            way, without going through the frame buffer.
+    @param  image
+            Full screen background as for SSD1306_display_image(),
+            usually in flash.
+    @param  overlay
+            w * pages bytes in the same layout, usually in RAM.
+    @param  x
+            First column of the overlay.
+    @param  page
+            First page (8 rows) of the overlay.
+    @param  w
+            Overlay columns.
+    @param  pages
+            Overlay pages.
+    @param  color
+            SSD1306_WHITE lights, SSD1306_BLACK clears and
+            SSD1306_INVERSE flips the pixels set in the overlay.
+    @return false if the overlay does not fit the display.
+    @note   Pages without overlay go by DMA straight from the image, the
+            others are merged into a page stripe while the page before is
+            on the bus. The overlay may be changed on return, the image
+            not while SSD1306_display_busy().
+*/
+bool SSD1306_display_image_overlay(const uint8_t *image, const uint8_t *overlay, uint8_t x, uint8_t page, uint8_t w, uint8_t pages, uint16_t color)
+{
+	uint8_t p, *out;
+	uint16_t i;
+
+	if (!SSD1306_rect_fits(x, page, w, pages))
+	{
+		return false;
+	}
 
-	platform_write_dma(SSD1306_SETSTARTLINE, buffer, buf_len);
+	// Pages held back for the panel go out first, not over the image
+	platform_wait_ready();
+	PROF_BEGIN(PROF_REPAINT);
+	TRACE(TRACE_REPAINT, 0xFFFF);
+	SSD1306_invalidate();
+	// Pages follow each other in the address window
+	SSD1306_send_window(0, (SSD1306_HEIGHT + 7) / 8 - 1, NULL, 0);
+	for (p = 0; p < (SSD1306_HEIGHT + 7) / 8; p++)
+	{
+		if ((p < page) || (p >= page + pages))
+		{
+			platform_write_dma(SSD1306_SETSTARTLINE, (uint8_t *)&image[p * SSD1306_WIDTH], SSD1306_WIDTH);
+			continue;
+		}
+
+		out = SSD1306_next_stripe();
+		memcpy(out, &image[p * SSD1306_WIDTH], SSD1306_WIDTH);
+		for (i = 0; i < w; i++)
+		{
+			switch (color)
+			{
+				case SSD1306_WHITE:
+					out[x + i] |= overlay[(p - page) * w + i];
+					break;
+				case SSD1306_BLACK:
+					out[x + i] &= ~overlay[(p - page) * w + i];
+					break;
+				case SSD1306_INVERSE:
+					out[x + i] ^= overlay[(p - page) * w + i];
+					break;
+			}
+		}
+		platform_write_dma(SSD1306_SETSTARTLINE, out, SSD1306_WIDTH);
+	}
+	PROF_END(PROF_REPAINT);
+	return true;
+}
+
+/*!
+    @brief  Set the display RAM row shown first, scrolling the whole
+            display vertically without touching its contents.
+    @param  line
+            Display RAM row, 0 to 63, wraps around.
+    @return None (void).
+    @note   This has an immediate effect on the display, the RAM buffer is
+            not changed.
+*/
+void SSD1306_set_start_line(uint8_t line)
+{
+	TRACE(TRACE_START_LINE, line & 0x3F);
+	SSD1306_send_com(SSD1306_SETSTARTLINE | (line & 0x3F));
+}
+
+/*!
+    @brief  Check for a display transfer still in progress.
+    @return true while a repaint is held back, queued or on the bus.
+    @note   Held back pages go out from the main loop, do not busy wait
+            for this to turn false, see SSD1306_display_wait().
+*/
+bool SSD1306_display_busy(void)
+{
+#ifdef USE_HAL_DRIVER
+	return platform_pending(panel) || panel->dirty;
+#else
+	return false;
+#endif
+}
+
+/*!
+    @brief  Wait for the display transfers of the selected panel, sending
+            the pages held back for them first.
+    @return None (void).
+    @note   Busy waits, from thread context only.
+*/
+void SSD1306_display_wait(void)
+{
+	platform_wait_ready();
 }
 
 /*!
@@ -571,6 +1651,7 @@ void SSD1306_display_repaint(void)
 /* To scroll the whole display, run: display.startscrollright(0x00, 0x0F) */
 void SSD1306_start_scroll_right(uint8_t start, uint8_t stop)
 {
+	TRACE(TRACE_SCROLL, SSD1306_RIGHT_HORIZONTAL_SCROLL);
 	SSD1306_send_com(SSD1306_RIGHT_HORIZONTAL_SCROLL);
 	SSD1306_send_com(0x00);
 
@@ -594,6 +1675,7 @@ void SSD1306_start_scroll_right(uint8_t start, uint8_t stop)
 /* To scroll the whole display, run: display.startscrollleft(0x00, 0x0F) */
 void SSD1306_start_scroll_left(uint8_t start, uint8_t stop)
 {
+	TRACE(TRACE_SCROLL, SSD1306_LEFT_HORIZONTAL_SCROLL);
 	SSD1306_send_com(SSD1306_LEFT_HORIZONTAL_SCROLL);
 	SSD1306_send_com(0x00);
 
@@ -617,6 +1699,7 @@ void SSD1306_start_scroll_left(uint8_t start, uint8_t stop)
 /* display.startscrolldiagright(0x00, 0x0F) */
 void SSD1306_start_scroll_diagright(uint8_t start, uint8_t stop)
 {
+	TRACE(TRACE_SCROLL, SSD1306_VERTICAL_AND_RIGHT_HORIZONTAL_SCROLL);
 	SSD1306_send_com(SSD1306_SET_VERTICAL_SCROLL_AREA);
 	SSD1306_send_com(0x00);
   	SSD1306_send_com(SSD1306_HEIGHT);
@@ -643,6 +1726,7 @@ void SSD1306_start_scroll_diagright(uint8_t start, uint8_t stop)
 /* To scroll the whole display, run: display.startscrolldiagleft(0x00, 0x0F) */
 void SSD1306_start_scroll_diagleft(uint8_t start, uint8_t stop)
 {
+	TRACE(TRACE_SCROLL, SSD1306_VERTICAL_AND_LEFT_HORIZONTAL_SCROLL);
 	SSD1306_send_com(SSD1306_SET_VERTICAL_SCROLL_AREA);
 	SSD1306_send_com(0x00);
 	SSD1306_send_com(SSD1306_HEIGHT);
@@ -664,6 +1748,7 @@ void SSD1306_start_scroll_diagleft(uint8_t start, uint8_t stop)
 */
 void SSD1306_stop_scroll(void)
 {
+	TRACE(TRACE_SCROLL, SSD1306_DEACTIVATE_SCROLL);
 	SSD1306_send_com(SSD1306_DEACTIVATE_SCROLL);
 }
 
@@ -703,12 +1788,164 @@ void SSD1306_set_contrast(uint8_t contrast)
     SSD1306_send_com(contrast);
 }
 
+/* Send the segment remap and COM scan direction for rotation and mirroring */
+static void SSD1306_set_orientation(void)
+{
+	bool flip = (rotation == 2) && (buffer_rotation == 0);
+
+	SSD1306_send_com(SSD1306_SEGREMAP | ((flip != mirror_x) ? 0x01 : 0x00));
+	SSD1306_send_com((flip != mirror_y) ? SSD1306_COMSCANINC : SSD1306_COMSCANDEC);
+}
+
+/*!
+    @brief  Set the display rotation.
+    @param  rot
+            0 to 3, in 90 degree steps.
+    @return None (void).
+    @note   With SSD1306_HW_ROTATION rotation 2 is done by the controller
+            flipping its segment and COM scan order, drawing then runs
+            unrotated. This flips what is already on the display right
+            away, redraw after changing between rotations 0 and 2.
+            With SSD1306_TRANSPOSE_FLUSH rotations 1 and 3 turn the buffer
+            into an unrotated canvas, redraw after changing to or from them.
+*/
 void SSD1306_set_rotation(uint8_t rot)
 {
-	rotation = rot;
+	rotation = rot & 3;
+	SSD1306_set_canvas(SSD1306_TRANSPOSE_FLUSH && (rotation & 1));
+	SSD1306_set_orientation();
 }
 
 uint8_t SSD1306_get_rotation(void)
 {
 	return rotation;
 }
+
+/*!
+    @brief  Get the part of the rotation applied when drawing into the
+            buffer, use it for code that works on the buffer layout.
+    @return Rotation 0 to 3, 0 when the controller or the flush does the
+            rotation.
+*/
+uint8_t SSD1306_get_buffer_rotation(void)
+{
+	return buffer_rotation;
+}
+
+/*!
+    @brief  Get the buffer width, the number of bytes in one buffer page.
+    @return SSD1306_WIDTH, or SSD1306_HEIGHT while the buffer is a
+            canvas for rotation 1 or 3.
+*/
+int16_t SSD1306_get_buffer_width(void)
+{
+	return buffer_width;
+}
+
+/*!
+    @brief  Mirror the display in hardware, on top of the rotation.
+    @param  x
+            Mirror along the segment (column) axis of the panel.
+    @param  y
+            Mirror along the COM (row) axis of the panel.
+    @return None (void).
+    @note   This has an immediate effect on the display, the buffer is
+            not changed.
+*/
+void SSD1306_set_mirror(bool x, bool y)
+{
+	mirror_x = x;
+	mirror_y = y;
+	SSD1306_set_orientation();
+}
+
+/*!
+    @brief  Direct drawing, repaints and commands to another panel.
+    @param  p
+            Panel to select, initialize it with SSD1306_init() once while
+            selected.
+    @return None (void).
+    @note   Transfers of the previous panel keep running.
+*/
+void SSD1306_select_panel(SSD1306_panel_t *p)
+{
+	panel = p;
+	buffer = p->buffer;
+	SSD1306_set_canvas(canvas);
+}
+
+/*!
+    @brief  Get the panel drawing goes to.
+    @return The panel last selected, a built-in one on I2CBUS_BUS1 at
+            SSD1306_I2C_ADDRESS before that.
+*/
+SSD1306_panel_t* SSD1306_get_panel(void)
+{
+	return panel;
+}
+
+/*!
+    @brief  Repaint several panels at once, each bus sends its frames in
+            parallel with the others.
+    @param  panels
+            Panels to repaint, already drawn.
+    @param  count
+            Number of panels.
+    @param  done
+            Called once every frame has gone out, from the main loop, or
+            before returning if they already have.
+            May be NULL.
+    @param  ctx
+            Passed to done.
+    @return false if an earlier SSD1306_repaint_all() is still running.
+    @note   Panels sharing a bus still go one after the other. The
+            selected panel is kept. Frames that fail on the bus count as
+            done, see I2CBUS_get_stats() for errors.
+*/
+bool SSD1306_repaint_all(SSD1306_panel_t * const *panels, uint8_t count, SSD1306_done_t done, void *ctx)
+{
+	SSD1306_panel_t *selected = panel;
+	uint8_t i;
+
+	if (group_left)
+	{
+		return false;
+	}
+
+	group_done = done;
+	group_ctx = ctx;
+	// One extra so the group cannot finish while panels are still joining
+	group_left = count + 1;
+	for (i = 0; i < count; i++)
+	{
+		SSD1306_select_panel(panels[i]);
+		SSD1306_display_repaint();
+		platform_group_join(panels[i]);
+	}
+	SSD1306_select_panel(selected);
+	platform_group_join(NULL);
+	return true;
+}
+
+/*!
+    @brief  Check for an SSD1306_repaint_all() still in progress.
+    @return true until the last of its frames has gone out.
+    @note   Turns false from the main loop, do not busy wait for it.
+*/
+bool SSD1306_repaint_all_busy(void)
+{
+	return group_left != 0;
+}
+
+#ifndef USE_HAL_DRIVER
+/*!
+    @brief  Hand what would go on the bus to a function, host builds only.
+    @param  fn
+            Called with every command and data write, NULL to drop them.
+    @return None (void).
+*/
+void SSD1306_set_host_write(SSD1306_host_write_t fn)
+{
+	host_write = fn;
+}
+#endif
@@ -0,0 +1,391 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "TERM.h"
+#ifdef USE_HAL_DRIVER
+#include "SERIAL.h"
+#endif
+
+#define TERM_ATTR_INVERSE 0x01
+
+#define TERM_MAX_PARAMS 2
+#define TERM_PARAM_MAX 9999	// Parameters saturate here, far off any screen
+
+typedef enum
+{
+	TERM_STATE_TEXT,
+	TERM_STATE_ESC,
+	TERM_STATE_CSI
+} TERM_state_t;
+
+static uint8_t cells[TERM_ROWS][TERM_COLUMNS];
+static uint8_t attrs[TERM_ROWS][TERM_COLUMNS];
+static uint32_t dirty[TERM_ROWS];	// One bit per column
+static uint8_t row, col, attr;
+static TERM_state_t state;
+static uint16_t params[TERM_MAX_PARAMS];
+static uint8_t param_count;
+#ifdef USE_HAL_DRIVER
+static uint32_t last_render;
+#endif
+
+static void TERM_set_cell(uint8_t r, uint8_t c, uint8_t ch, uint8_t a)
+{
+	if ((cells[r][c] != ch) || (attrs[r][c] != a))
+	{
+		cells[r][c] = ch;
+		attrs[r][c] = a;
+		dirty[r] |= 1UL << c;
+	}
+}
+
+static void TERM_erase(uint8_t r, uint8_t from, uint8_t to)
+{
+	// Up to the cursor ends one past the grid while a wrap is pending
+	if (to > TERM_COLUMNS)
+	{
+		to = TERM_COLUMNS;
+	}
+	for (; from < to; from++)
+	{
+		TERM_set_cell(r, from, ' ', 0);
+	}
+}
+
+static void TERM_line_feed(void)
+{
+	uint8_t r, c;
+
+	if (row < TERM_ROWS - 1)
+	{
+		row++;
+		return;
+	}
+
+	// Scroll the grid, cells that end up unchanged stay clean
+	for (r = 0; r < TERM_ROWS - 1; r++)
+	{
+		for (c = 0; c < TERM_COLUMNS; c++)
+		{
+			TERM_set_cell(r, c, cells[r + 1][c], attrs[r + 1][c]);
+		}
+	}
+	TERM_erase(TERM_ROWS - 1, 0, TERM_COLUMNS);
+}
+
+static uint16_t TERM_param(uint8_t i, uint16_t def)
+{
+	return (i < param_count && params[i]) ? params[i] : def;
+}
+
+static uint8_t TERM_clamp(int16_t v, uint8_t max)
+{
+	return (v < 0) ? 0 : ((v >= max) ? max - 1 : v);
+}
+
+static void TERM_csi(uint8_t final)
+{
+	uint8_t r, i;
+
+	switch (final)
+	{
+		case 'A':
+			row = TERM_clamp(row - TERM_param(0, 1), TERM_ROWS);
+			break;
+		case 'B':
+			row = TERM_clamp(row + TERM_param(0, 1), TERM_ROWS);
+			break;
+		case 'C':
+			col = TERM_clamp(col + TERM_param(0, 1), TERM_COLUMNS);
+			break;
+		case 'D':
+			col = TERM_clamp(col - TERM_param(0, 1), TERM_COLUMNS);
+			break;
+		case 'H':
+		case 'f':
+			row = TERM_clamp(TERM_param(0, 1) - 1, TERM_ROWS);
+			col = TERM_clamp(TERM_param(1, 1) - 1, TERM_COLUMNS);
+			break;
+		case 'J':
+			switch (TERM_param(0, 0))
+			{
+				case 0:
+					TERM_erase(row, col, TERM_COLUMNS);
+					for (r = row + 1; r < TERM_ROWS; r++)
+					{
+						TERM_erase(r, 0, TERM_COLUMNS);
+					}
+					break;
+				case 1:
+					for (r = 0; r < row; r++)
+					{
+						TERM_erase(r, 0, TERM_COLUMNS);
+					}
+					TERM_erase(row, 0, col + 1);
+					break;
+				default:
+					for (r = 0; r < TERM_ROWS; r++)
+					{
+						TERM_erase(r, 0, TERM_COLUMNS);
+					}
+					break;
+			}
+			break;
+		case 'K':
+			switch (TERM_param(0, 0))
+			{
+				case 0:
+					TERM_erase(row, col, TERM_COLUMNS);
+					break;
+				case 1:
+					TERM_erase(row, 0, col + 1);
+					break;
+				default:
+					TERM_erase(row, 0, TERM_COLUMNS);
+					break;
+			}
+			break;
+		case 'm':
+			for (i = 0; i < param_count || i == 0; i++)
+			{
+				switch (TERM_param(i, 0))
+				{
+					case 0:
+					case 27:
+						attr &= ~TERM_ATTR_INVERSE;
+						break;
+					case 7:
+						attr |= TERM_ATTR_INVERSE;
+						break;
+				}
+			}
+			break;
+	}
+}
+
+static void TERM_put(uint8_t ch)
+{
+	switch (state)
+	{
+		case TERM_STATE_ESC:
+			if (ch == '[')
+			{
+				state = TERM_STATE_CSI;
+				param_count = 0;
+				params[0] = 0;
+				return;
+			}
+			if (ch == 'c')
+			{
+				TERM_init();
+			}
+			state = TERM_STATE_TEXT;
+			return;
+
+		case TERM_STATE_CSI:
+			if (ch >= '0' && ch <= '9')
+			{
+				if (param_count == 0)
+				{
+					param_count = 1;
+				}
+				if ((param_count <= TERM_MAX_PARAMS) && (params[param_count - 1] <= (TERM_PARAM_MAX - 9) / 10))
+				{
+					params[param_count - 1] = params[param_count - 1] * 10 + (ch - '0');
+				}
+				else if (param_count <= TERM_MAX_PARAMS)
+				{
+					params[param_count - 1] = TERM_PARAM_MAX;
+				}
+			}
+			else if (ch == ';')
+			{
+				if (param_count == 0)
+				{
+					param_count = 1;
+				}
+				if (++param_count <= TERM_MAX_PARAMS)
+				{
+					params[param_count - 1] = 0;
+				}
+			}
+			else if (ch >= 0x40 && ch <= 0x7E)
+			{
+				if (param_count > TERM_MAX_PARAMS)
+				{
+					param_count = TERM_MAX_PARAMS;
+				}
+				TERM_csi(ch);
+				state = TERM_STATE_TEXT;
+			}
+			return;
+
+		default:
+			break;
+	}
+
+	switch (ch)
+	{
+		case 0x1B:
+			state = TERM_STATE_ESC;
+			break;
+		case '\r':
+			col = 0;
+			break;
+		case '\n':
+			TERM_line_feed();
+			break;
+		case '\b':
+			if (col > 0)
+			{
+				col--;
+			}
+			break;
+		case '\t':
+			col = TERM_clamp((col + 8) & ~7, TERM_COLUMNS);
+			break;
+		default:
+			if (ch < 0x20 || ch == 0x7F)
+			{
+				break;
+			}
+			if (col >= TERM_COLUMNS)
+			{
+				// Deferred wrap, the last column is usable without scrolling
+				col = 0;
+				TERM_line_feed();
+			}
+			TERM_set_cell(row, col++, ch, attr);
+			break;
+	}
+}
+
+/* Send the display page holding a grid row, landscape rotations only */
+static void TERM_repaint_row(uint8_t r)
+{
+	SSD1306_display_repaint_page((SSD1306_get_buffer_rotation() == 2) ? TERM_ROWS - 1 - r : r);
+}
+
+/*!
+    @brief  Clear the terminal grid and the display.
+    @return None (void).
+*/
+void TERM_init(void)
+{
+	memset(cells, ' ', sizeof(cells));
+	memset(attrs, 0, sizeof(attrs));
+	memset(dirty, 0, sizeof(dirty));
+	row = col = attr = 0;
+	state = TERM_STATE_TEXT;
+
+	SSD1306_display_clear();
+	SSD1306_display_repaint();
+}
+
+/*!
+    @brief  Interpret received bytes into the character grid.
+    @param  data
+            Text with optional CR, LF, BS, TAB and the ANSI sequences
+            ESC[nA/B/C/D, ESC[r;cH, ESC[nJ, ESC[nK, ESC[0m/7m/27m, ESC c.
+    @param  len
+            Number of bytes.
+    @return None (void).
+    @note   Only the grid is changed, see TERM_render().
+*/
+void TERM_feed(const uint8_t *data, uint16_t len)
+{
+	while (len--)
+	{
+		TERM_put(*data++);
+	}
+}
+
+/*!
+    @brief  Draw changed cells and send the pages that contain them.
+    @return None (void).
+*/
+void TERM_render(void)
+{
+	uint8_t r, c, fg, bg;
+	int16_t x, y;
+	bool full = false;
+
+	for (r = 0; r < TERM_ROWS; r++)
+	{
+		if (!dirty[r])
+		{
+			continue;
+		}
+		for (c = 0; c < TERM_COLUMNS; c++)
+		{
+			if (dirty[r] & (1UL << c))
+			{
+				x = c * GFX_CHAR_ADVANCE;
+				y = r * GFX_CHAR_HEIGHT;
+				fg = (attrs[r][c] & TERM_ATTR_INVERSE) ? SSD1306_BLACK : SSD1306_WHITE;
+				bg = (attrs[r][c] & TERM_ATTR_INVERSE) ? SSD1306_WHITE : SSD1306_BLACK;
+				GFX_draw_char(x, y, cells[r][c], fg, bg, 1, 1);
+				GFX_draw_fill_rect(x + GFX_CHAR_WIDTH + 1, y, GFX_CHAR_ADVANCE - GFX_CHAR_WIDTH - 1, GFX_CHAR_HEIGHT, bg);
+			}
+		}
+		dirty[r] = 0;
+
+		if ((SSD1306_get_rotation() & 1) == 0)
+		{
+			TERM_repaint_row(r);
+		}
+		else
+		{
+			full = true;
+		}
+	}
+
+	if (full)
+	{
+		SSD1306_display_repaint();
+	}
+}
+
+#ifdef USE_HAL_DRIVER
+/*!
+    @brief  Poll function for the main loop, feeds received serial data to
+            the terminal and renders at the end of each burst.
+    @return None (void).
+*/
+void TERM_process(void)
+{
+	uint8_t chunk[32];
+	uint16_t n;
+
+	while ((n = SERIAL_read(chunk, sizeof(chunk))) > 0)
+	{
+		TERM_feed(chunk, n);
+	}
+
+	if (SERIAL_rx_idle() || (HAL_GetTick() - last_render) >= TERM_RENDER_INTERVAL)
+	{
+		TERM_render();
+		last_render = HAL_GetTick();
+	}
+}
+#endif
@@ -0,0 +1,150 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "TRACE.h"
+#include "PROF.h"
+#ifdef USE_HAL_DRIVER
+#include "main.h"
+#include "SERIAL.h"
+#endif
+
+#define TRACE_MASK (TRACE_SIZE - 1)
+
+static TRACE_event_t ring[TRACE_SIZE];
+static volatile uint32_t head;		// Total events recorded, never wraps in practice
+static volatile bool frozen;
+
+/*!
+    @brief  Append an event to the ring, normally through TRACE().
+    @param  event
+            Event code.
+    @param  arg
+            Event specific argument.
+    @return None (void).
+    @note   Safe from any context. A slot is claimed with an exclusive
+            access increment, an interrupt arriving in between claims the
+            next one.
+*/
+void TRACE_record(TRACE_event_id_t event, uint16_t arg)
+{
+	TRACE_event_t *e;
+	uint32_t i;
+
+	if (frozen)
+	{
+		return;
+	}
+#ifdef USE_HAL_DRIVER
+	do
+	{
+		i = __LDREXW(&head);
+	} while (__STREXW(i + 1, &head));
+	e = &ring[i & TRACE_MASK];
+	e->time = PROF_CYCLES();
+	e->context = __get_IPSR();
+#else
+	i = head++;
+	e = &ring[i & TRACE_MASK];
+	e->time = PROF_CYCLES();
+	e->context = 0;
+#endif
+	e->event = event;
+	e->arg = arg;
+}
+
+/*!
+    @brief  Forget all recorded events.
+    @return None (void).
+*/
+void TRACE_clear(void)
+{
+	head = 0;
+}
+
+/*!
+    @brief  Stop or resume recording, e.g. to keep the events leading up
+            to a fault.
+    @param  freeze
+            true to stop recording.
+    @return None (void).
+*/
+void TRACE_freeze(bool freeze)
+{
+	frozen = freeze;
+}
+
+/*!
+    @brief  Copy the recorded events out, oldest first.
+    @param  out
+            Receives the events.
+    @param  max
+            Capacity of out.
+    @return Number of events copied, the newest ones if out is too small.
+    @note   Freeze the trace first for a consistent copy.
+*/
+uint16_t TRACE_read(TRACE_event_t *out, uint16_t max)
+{
+	uint32_t end = head;
+	uint32_t n = (end < TRACE_SIZE) ? end : TRACE_SIZE;
+	uint32_t i;
+
+	if (n > max)
+	{
+		n = max;
+	}
+	for (i = end - n; i != end; i++)
+	{
+		*out++ = ring[i & TRACE_MASK];
+	}
+	return n;
+}
+
+/*!
+    @brief  Print the recorded events over the serial port, oldest first:
+            "trace: begin <events> <cpu Hz>", then one
+            "trace: <cycles hex> <event> <context> <arg>" line per event
+            and "trace: end".
+    @return None (void).
+    @note   Blocks until sent. Recording is frozen meanwhile, events from
+            interrupts during the dump are lost.
+*/
+void TRACE_dump(void)
+{
+#ifdef USE_HAL_DRIVER
+	uint32_t end, i, n;
+	TRACE_event_t *e;
+	bool was_frozen = frozen;
+
+	frozen = true;
+	end = head;
+	n = (end < TRACE_SIZE) ? end : TRACE_SIZE;
+	SERIAL_printf("trace: begin %lu %lu\r\n", n, SystemCoreClock);
+	for (i = end - n; i != end; i++)
+	{
+		e = &ring[i & TRACE_MASK];
+		SERIAL_printf("trace: %08lx %u %u %u\r\n", e->time, e->event, e->context, e->arg);
+	}
+	SERIAL_print("trace: end\r\n");
+	frozen = was_frozen;
+#endif
+}
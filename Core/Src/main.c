@@ -27,6 +27,16 @@
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include "GFX.h"
+#include "SERIAL.h"
+#include "TERM.h"
+#include "RFB.h"
+#include "SNAPSHOT.h"
+#include "SELFTEST.h"
+#include "PROF.h"
+#include "TRACE.h"
+#include "MEM.h"
+#include "M2M.h"
+#include "SCHED.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -36,6 +46,14 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
+/* Application selected at build time */
+#define APP_MODE_DEMO 0			// Static text
+#define APP_MODE_TERMINAL 1		// Serial terminal on USART2
+#define APP_MODE_REMOTE 2		// Remote frame buffer on USART2
+
+#ifndef APP_MODE
+#define APP_MODE APP_MODE_DEMO
+#endif
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -52,7 +70,11 @@
 /* Private function prototypes -----------------------------------------------*/
 void SystemClock_Config(void);
 /* USER CODE BEGIN PFP */
-
+#if APP_MODE == APP_MODE_DEMO
+static void debug_command_process(void);
+#elif APP_MODE == APP_MODE_REMOTE
+static void remote_process(void);
+#endif
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
@@ -92,13 +114,40 @@ int main(void)
   MX_USART2_UART_Init();
   MX_I2C1_Init();
   /* USER CODE BEGIN 2 */
+#if I2CBUS_I2C2
+  MX_I2C2_Init();
+#endif
+  PROF_init();
+  M2M_init();
   SSD1306_init();
+  SERIAL_init();
+  /* Holding the user button through reset runs the throughput self-test */
+  if (HAL_GPIO_ReadPin(B1_GPIO_Port, B1_Pin) == GPIO_PIN_RESET)
+  {
+    while (1)
+    {
+      SELFTEST_run();
+      HAL_Delay(SELFTEST_RESULT_MS);
+    }
+  }
+  /* User button sends a snapshot of the frame buffer over USART2 */
+  HAL_NVIC_SetPriority(EXTI15_10_IRQn, 2, 0);
+  HAL_NVIC_EnableIRQ(EXTI15_10_IRQn);
+#if APP_MODE == APP_MODE_TERMINAL
+  TERM_init();
+  SCHED_add_poll(TERM_process);
+#elif APP_MODE == APP_MODE_REMOTE
+  RFB_init();
+  SCHED_add_poll(remote_process);
+#else
+  SCHED_add_poll(debug_command_process);
   //GFX_draw_fill_rect(0, 0, 64, 32, WHITE);
   //GFX_draw_fill_rect(64, 32, 64, 32, WHITE);
   //GFX_draw_string(0, 25, (unsigned char *)"g\313\317", WHITE, BLACK, 2, 2);
   //GFX_draw_string(0, 0, (unsigned char *)"\311\312\313\314\315\316\317\320\321", WHITE, BLACK, 2, 2);
   GFX_draw_string(3, 25, (unsigned char *)"***** ***", WHITE, BLACK, 2, 2);
   SSD1306_display_repaint();
+#endif
   /* USER CODE END 2 */
 
   /* Infinite loop */
@@ -108,6 +157,7 @@ int main(void)
     /* USER CODE END WHILE */
 
     /* USER CODE BEGIN 3 */
+    SCHED_run_once();
   }
   /* USER CODE END 3 */
 }
@@ -159,7 +209,62 @@ void SystemClock_Config(void)
 }
 
 /* USER CODE BEGIN 4 */
+#if APP_MODE == APP_MODE_DEMO
+/*
+ * Single character debug commands on USART2, the other modes use the
+ * serial port for their own data:
+ *   t - dump the event trace, c - clear it
+ *   p - dump the profiling statistics, r - reset them
+ *   m - report RAM usage, s - scheduler statistics
+ */
+static void debug_command_process(void)
+{
+  uint8_t c;
+
+  /* Replies would land in the middle of a snapshot, leave commands queued */
+  while (!SNAPSHOT_busy() && SERIAL_read(&c, 1))
+  {
+    switch (c)
+    {
+      case 't':
+        TRACE_dump();
+        break;
+      case 'c':
+        TRACE_clear();
+        break;
+      case 'p':
+        PROF_dump();
+        break;
+      case 'r':
+        PROF_reset();
+        break;
+      case 'm':
+        MEM_report();
+        break;
+      case 's':
+        SCHED_report();
+        break;
+    }
+  }
+}
+#elif APP_MODE == APP_MODE_REMOTE
+/* Frames wait in the receive buffer while a snapshot goes out, as do their acks */
+static void remote_process(void)
+{
+  if (!SNAPSHOT_busy())
+  {
+    RFB_process();
+  }
+}
+#endif
 
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+  if (GPIO_Pin == B1_Pin)
+  {
+    SNAPSHOT_request(SNAPSHOT_FORMAT_PBM);
+  }
+}
 /* USER CODE END 4 */
 
 /**
@@ -23,6 +23,10 @@
 #include "stm32f3xx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "SERIAL.h"
+#include "PROF.h"
+#include "I2CBUS.h"
+#include "M2M.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -59,6 +63,12 @@
 extern DMA_HandleTypeDef hdma_i2c1_tx;
 extern I2C_HandleTypeDef hi2c1;
 /* USER CODE BEGIN EV */
+extern DMA_HandleTypeDef hdma_usart2_tx;
+extern UART_HandleTypeDef huart2;
+#if I2CBUS_I2C2
+extern DMA_HandleTypeDef hdma_i2c2_tx;
+extern I2C_HandleTypeDef hi2c2;
+#endif
 
 /* USER CODE END EV */
 
@@ -183,11 +193,11 @@ void PendSV_Handler(void)
 void SysTick_Handler(void)
 {
   /* USER CODE BEGIN SysTick_IRQn 0 */
-
+  PROF_BEGIN(PROF_IRQ_SYSTICK);
   /* USER CODE END SysTick_IRQn 0 */
   HAL_IncTick();
   /* USER CODE BEGIN SysTick_IRQn 1 */
-
+  PROF_END(PROF_IRQ_SYSTICK);
   /* USER CODE END SysTick_IRQn 1 */
 }
 
@@ -204,11 +214,11 @@ void SysTick_Handler(void)
 void DMA1_Channel6_IRQHandler(void)
 {
   /* USER CODE BEGIN DMA1_Channel6_IRQn 0 */
-
+  PROF_BEGIN(PROF_IRQ_I2C1_DMA);
   /* USER CODE END DMA1_Channel6_IRQn 0 */
   HAL_DMA_IRQHandler(&hdma_i2c1_tx);
   /* USER CODE BEGIN DMA1_Channel6_IRQn 1 */
-
+  PROF_END(PROF_IRQ_I2C1_DMA);
   /* USER CODE END DMA1_Channel6_IRQn 1 */
 }
 
@@ -218,15 +228,80 @@ void DMA1_Channel6_IRQHandler(void)
 void I2C1_EV_IRQHandler(void)
 {
   /* USER CODE BEGIN I2C1_EV_IRQn 0 */
-
+  PROF_BEGIN(PROF_IRQ_I2C1_EV);
+  I2CBUS_irq_handler(I2CBUS_BUS1);
   /* USER CODE END I2C1_EV_IRQn 0 */
   HAL_I2C_EV_IRQHandler(&hi2c1);
   /* USER CODE BEGIN I2C1_EV_IRQn 1 */
-
+  PROF_END(PROF_IRQ_I2C1_EV);
   /* USER CODE END I2C1_EV_IRQn 1 */
 }
 
 /* USER CODE BEGIN 1 */
 
+/**
+  * @brief This function handles USART2 global interrupt / USART2 wake-up interrupt through EXTI line 26.
+  */
+void USART2_IRQHandler(void)
+{
+  PROF_BEGIN(PROF_IRQ_USART2);
+  SERIAL_irq_handler();
+  HAL_UART_IRQHandler(&huart2);
+  PROF_END(PROF_IRQ_USART2);
+}
+
+/**
+  * @brief This function handles DMA1 channel7 global interrupt.
+  */
+void DMA1_Channel7_IRQHandler(void)
+{
+  PROF_BEGIN(PROF_IRQ_USART2_DMA);
+  HAL_DMA_IRQHandler(&hdma_usart2_tx);
+  PROF_END(PROF_IRQ_USART2_DMA);
+}
+
+/**
+  * @brief This function handles EXTI line[15:10] interrupts.
+  */
+void EXTI15_10_IRQHandler(void)
+{
+  PROF_BEGIN(PROF_IRQ_EXTI15_10);
+  HAL_GPIO_EXTI_IRQHandler(B1_Pin);
+  PROF_END(PROF_IRQ_EXTI15_10);
+}
+
+#if I2CBUS_I2C2
+/**
+  * @brief This function handles DMA1 channel4 global interrupt.
+  */
+void DMA1_Channel4_IRQHandler(void)
+{
+  PROF_BEGIN(PROF_IRQ_I2C2_DMA);
+  HAL_DMA_IRQHandler(&hdma_i2c2_tx);
+  PROF_END(PROF_IRQ_I2C2_DMA);
+}
+
+/**
+  * @brief This function handles I2C2 event global interrupt / I2C2 wake-up interrupt through EXTI line 24.
+  */
+void I2C2_EV_IRQHandler(void)
+{
+  PROF_BEGIN(PROF_IRQ_I2C2_EV);
+  I2CBUS_irq_handler(I2CBUS_BUS2);
+  HAL_I2C_EV_IRQHandler(&hi2c2);
+  PROF_END(PROF_IRQ_I2C2_EV);
+}
+#endif
+
+/**
+  * @brief This function handles DMA2 channel1 global interrupt.
+  */
+void DMA2_Channel1_IRQHandler(void)
+{
+  PROF_BEGIN(PROF_IRQ_M2M_DMA);
+  M2M_irq_handler();
+  PROF_END(PROF_IRQ_M2M_DMA);
+}
+
 /* USER CODE END 1 */
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
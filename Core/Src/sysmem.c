@@ -30,6 +30,12 @@
  */
 static uint8_t *__sbrk_heap_end = NULL;
 
+/**
+ * Most bytes ever taken from the heap, and number of refused requests
+ */
+static uint32_t __sbrk_heap_peak = 0;
+static uint32_t __sbrk_failed = 0;
+
 /**
  * @brief _sbrk() allocates memory to the newlib heap and is used by malloc
  *        and others from the C library
@@ -69,6 +75,7 @@ void *_sbrk(ptrdiff_t incr)
   /* Protect heap from growing into the reserved MSP stack */
   if (__sbrk_heap_end + incr > max_heap)
   {
+    __sbrk_failed++;
     errno = ENOMEM;
     return (void *)-1;
   }
@@ -76,5 +83,26 @@ void *_sbrk(ptrdiff_t incr)
   prev_heap_end = __sbrk_heap_end;
   __sbrk_heap_end += incr;
 
+  if ((uint32_t)(__sbrk_heap_end - &_end) > __sbrk_heap_peak)
+  {
+    __sbrk_heap_peak = __sbrk_heap_end - &_end;
+  }
+
   return (void *)prev_heap_end;
 }
+
+/**
+ * @brief _sbrk_usage() reports how much of the newlib heap _sbrk() handed out
+ *
+ * @param used Receives the bytes currently taken from the heap
+ * @param peak Receives the most bytes ever taken from the heap
+ * @param failed Receives the number of requests refused with ENOMEM
+ */
+void _sbrk_usage(uint32_t *used, uint32_t *peak, uint32_t *failed)
+{
+  extern uint8_t _end; /* Symbol defined in the linker script */
+
+  *used = (NULL == __sbrk_heap_end) ? 0 : (uint32_t)(__sbrk_heap_end - &_end);
+  *peak = __sbrk_heap_peak;
+  *failed = __sbrk_failed;
+}
@@ -90,6 +90,20 @@ LoopFillZerobss:
 	cmp	r2, r3
 	bcc	FillZerobss
 
+/* Paint the free RAM between heap start and stack top, the stack
+   high-water scan in MEM.c looks for the first overwritten word.
+   The pattern must match MEM_PAINT in MEM.h. */
+	ldr	r2, =_end
+	ldr	r3, =_estack
+	ldr	r1, =0xA5A5A5A5
+	b	LoopPaintStack
+PaintStack:
+	str	r1, [r2], #4
+
+LoopPaintStack:
+	cmp	r2, r3
+	bcc	PaintStack
+
 /* Call the clock system intitialization function.*/
     bl  SystemInit
 /* Call static constructors */
@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+"""Compare two PBM frame buffer snapshots, e.g. one saved by a host build
+with SNAPSHOT_save() against a reference image.
+
+Prints the number of differing pixels and their bounding box, optionally
+writes an XOR image of the differences, and exits with status 1 if the
+images differ.
+
+  pbm_diff.py expected.pbm actual.pbm --diff diff.pbm --show
+"""
+
+import argparse
+import os
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from rfb_send import read_pbm  # noqa: E402
+
+
+def write_pbm(path, pixels):
+    h = len(pixels)
+    w = len(pixels[0]) if h else 0
+    rows = bytearray()
+    for row in pixels:
+        for bx in range(0, w, 8):
+            b = 0
+            for x in range(bx, min(bx + 8, w)):
+                if row[x]:
+                    b |= 0x80 >> (x - bx)
+            rows.append(b)
+    with open(path, "wb") as f:
+        f.write(b"P4\n%d %d\n" % (w, h) + bytes(rows))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("expected")
+    parser.add_argument("actual")
+    parser.add_argument("--diff", metavar="PBM", help="write differing pixels as a PBM image")
+    parser.add_argument("--show", action="store_true",
+                        help="print the differing area, '+' set only in actual, '-' set only in expected")
+    args = parser.parse_args()
+
+    a = read_pbm(args.expected)
+    b = read_pbm(args.actual)
+    if (len(a), len(a[0])) != (len(b), len(b[0])):
+        print("size differs: %dx%d vs %dx%d" % (len(a[0]), len(a), len(b[0]), len(b)))
+        return 1
+
+    h, w = len(a), len(a[0])
+    diff = [[a[y][x] ^ b[y][x] for x in range(w)] for y in range(h)]
+    points = [(x, y) for y in range(h) for x in range(w) if diff[y][x]]
+    if args.diff:
+        write_pbm(args.diff, diff)
+    if not points:
+        print("identical")
+        return 0
+
+    x0 = min(p[0] for p in points)
+    x1 = max(p[0] for p in points)
+    y0 = min(p[1] for p in points)
+    y1 = max(p[1] for p in points)
+    print("%d pixels differ in x %d..%d, y %d..%d" % (len(points), x0, x1, y0, y1))
+    if args.show:
+        for y in range(y0, y1 + 1):
+            print("".join("+" if b[y][x] and not a[y][x] else "-" if a[y][x] and not b[y][x]
+                          else "#" if a[y][x] else "." for x in range(x0, x1 + 1)))
+    return 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
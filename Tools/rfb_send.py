@@ -0,0 +1,256 @@
+#!/usr/bin/env python3
+"""Send frames to the remote frame buffer (APP_MODE_REMOTE) over a serial
+port, see Core/Inc/RFB.h for the protocol.
+
+Each frame is sent as a full, run length coded or delta frame, whichever
+is smallest. Images are PBM files (P1 or P4) of the display size.
+
+  rfb_send.py /dev/ttyACM0 splash.pbm
+  rfb_send.py /dev/ttyACM0 --demo 200
+  rfb_send.py /dev/pts/5 --no-ack --demo 10     # test against a pty
+  rfb_send.py - --no-ack frame.pbm > frame.bin  # raw stream to stdout
+"""
+
+import argparse
+import os
+import select
+import sys
+import termios
+import time
+import tty
+
+WIDTH = 128
+HEIGHT = 64
+PAGES = (HEIGHT + 7) // 8
+
+SYNC = b"\xA5\x5A"
+FRAME_FULL = 0x01
+FRAME_RLE = 0x02
+FRAME_DELTA = 0x03
+ACK = 0x06
+NAK = 0x15
+
+BAUDS = {
+    38400: termios.B38400,
+    115200: termios.B115200,
+    230400: termios.B230400,
+    460800: termios.B460800,
+    921600: termios.B921600,
+}
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def frame(kind, payload):
+    body = bytes([kind, len(payload) & 0xFF, len(payload) >> 8]) + payload
+    crc = crc16(body)
+    return SYNC + body + bytes([crc & 0xFF, crc >> 8])
+
+
+def rle(data):
+    out = bytearray()
+    i = 0
+    literal = bytearray()
+
+    def flush():
+        while literal:
+            chunk = literal[:128]
+            out.append(len(chunk) - 1)
+            out.extend(chunk)
+            del literal[:128]
+
+    while i < len(data):
+        run = 1
+        while i + run < len(data) and data[i + run] == data[i] and run < 129:
+            run += 1
+        if run >= 2:
+            flush()
+            out.append(0x80 + run - 2)
+            out.append(data[i])
+            i += run
+        else:
+            literal.append(data[i])
+            i += 1
+    flush()
+    return bytes(out)
+
+
+def delta(prev, cur, gap=3):
+    """Patches covering every changed byte, merging spans closer than gap."""
+    out = bytearray()
+    for page in range(PAGES):
+        base = page * WIDTH
+        col = 0
+        while col < WIDTH:
+            if prev[base + col] == cur[base + col]:
+                col += 1
+                continue
+            start = end = col
+            while col < WIDTH and col - end <= gap and col - start < 255:
+                if prev[base + col] != cur[base + col]:
+                    end = col
+                col += 1
+            out += bytes([page, start, end - start + 1])
+            out += cur[base + start:base + end + 1]
+            col = end + 1
+    return bytes(out)
+
+
+def encode(prev, cur):
+    candidates = [(FRAME_FULL, bytes(cur)), (FRAME_RLE, rle(cur))]
+    if prev is not None:
+        candidates.append((FRAME_DELTA, delta(prev, cur)))
+    kind, payload = min(candidates, key=lambda c: len(c[1]))
+    return frame(kind, payload)
+
+
+def to_buffer(pixels, rotation):
+    """Pack rows of 0/1 pixels into display RAM pages like SSD1306_draw_pixel."""
+    buf = bytearray(WIDTH * PAGES)
+    h = len(pixels)
+    w = len(pixels[0]) if h else 0
+    for y in range(h):
+        for x in range(w):
+            if not pixels[y][x]:
+                continue
+            px, py = x, y
+            if rotation == 1:
+                px, py = WIDTH - y - 1, x
+            elif rotation == 2:
+                px, py = WIDTH - x - 1, HEIGHT - y - 1
+            elif rotation == 3:
+                px, py = y, HEIGHT - x - 1
+            if 0 <= px < WIDTH and 0 <= py < HEIGHT:
+                buf[px + (py // 8) * WIDTH] |= 1 << (py & 7)
+    return buf
+
+
+def read_pbm(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    pos = 0
+
+    def token():
+        nonlocal pos
+        while True:
+            while data[pos:pos + 1].isspace():
+                pos += 1
+            if data[pos:pos + 1] == b"#":
+                while data[pos:pos + 1] not in (b"\n", b""):
+                    pos += 1
+                continue
+            break
+        start = pos
+        while pos < len(data) and not data[pos:pos + 1].isspace():
+            pos += 1
+        return data[start:pos]
+
+    magic = token()
+    w, h = int(token()), int(token())
+    if magic == b"P4":
+        pos += 1
+        stride = (w + 7) // 8
+        return [[(data[pos + y * stride + x // 8] >> (7 - x % 8)) & 1 for x in range(w)] for y in range(h)]
+    if magic == b"P1":
+        bits = [c for c in data[pos:] if c in b"01"]
+        return [[bits[y * w + x] - ord("0") for x in range(w)] for y in range(h)]
+    raise ValueError("%s: not a PBM file" % path)
+
+
+def demo_frames(count, rotation):
+    w, h = (WIDTH, HEIGHT) if rotation % 2 == 0 else (HEIGHT, WIDTH)
+    x, y, dx, dy = 0, 0, 3, 2
+    for _ in range(count):
+        pixels = [[0] * w for _ in range(h)]
+        for yy in range(y, y + 12):
+            for xx in range(x, x + 12):
+                pixels[yy][xx] = 1
+        for xx in range(w):
+            pixels[0][xx] = pixels[h - 1][xx] = 1
+        yield pixels
+        if not 0 <= x + dx <= w - 12:
+            dx = -dx
+        if not 0 <= y + dy <= h - 12:
+            dy = -dy
+        x += dx
+        y += dy
+
+
+def open_port(path, baud):
+    if path == "-":
+        return sys.stdout.fileno()
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    if os.isatty(fd):
+        tty.setraw(fd)
+        attrs = termios.tcgetattr(fd)
+        attrs[4] = attrs[5] = BAUDS[baud]
+        termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    return fd
+
+
+def wait_ack(fd, timeout):
+    ready, _, _ = select.select([fd], [], [], timeout)
+    if not ready:
+        return None
+    return os.read(fd, 1)[:1]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("port", help="serial device, pty, or - for stdout")
+    parser.add_argument("images", nargs="*", help="PBM images to send in order")
+    parser.add_argument("--baud", type=int, default=460800, choices=sorted(BAUDS))
+    parser.add_argument("--rotation", type=int, default=2, choices=range(4),
+                        help="display rotation set on the device (default 2)")
+    parser.add_argument("--sw-rotation", action="store_true",
+                        help="device built with SSD1306_HW_ROTATION 0, rotation 2 is done in the buffer")
+    parser.add_argument("--demo", type=int, metavar="N", help="send N frames of a bouncing box")
+    parser.add_argument("--fps", type=float, default=0, help="limit frame rate")
+    parser.add_argument("--no-ack", action="store_true", help="do not wait for ACK/NAK")
+    args = parser.parse_args()
+
+    # Without --sw-rotation the controller flips the display for rotation 2
+    # and the buffer holds the frame unrotated
+    buffer_rotation = 0 if (args.rotation == 2 and not args.sw_rotation) else args.rotation
+
+    if args.demo:
+        frames = demo_frames(args.demo, args.rotation)
+    else:
+        frames = (read_pbm(p) for p in args.images)
+
+    fd = open_port(args.port, args.baud)
+    prev = None
+    sent = size = 0
+    start = time.time()
+    for pixels in frames:
+        cur = to_buffer(pixels, buffer_rotation)
+        data = encode(prev, cur)
+        while True:
+            os.write(fd, data)
+            if args.no_ack:
+                break
+            reply = wait_ack(fd, 1.0)
+            if reply == bytes([ACK]):
+                break
+            # NAK or timeout, resend as a full frame so no delta is lost
+            data = encode(None, cur)
+        prev = cur
+        sent += 1
+        size += len(data)
+        if args.fps:
+            time.sleep(max(0, start + sent / args.fps - time.time()))
+
+    elapsed = max(time.time() - start, 1e-6)
+    print("%d frames, %d bytes, %.1f fps" % (sent, size, sent / elapsed), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+"""Capture a frame buffer snapshot sent over the serial port (press the
+user button, or call SNAPSHOT_send()), see Core/Inc/SNAPSHOT.h.
+
+PBM snapshots are saved as they are, raw snapshots ('FB' header) are
+converted to PBM of the display RAM layout.
+
+  snapshot_recv.py /dev/ttyACM0 shot.pbm
+"""
+
+import argparse
+import os
+import select
+import sys
+import termios
+import tty
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from rfb_send import BAUDS  # noqa: E402
+
+
+def read_exact(fd, n, timeout):
+    data = b""
+    while len(data) < n:
+        ready, _, _ = select.select([fd], [], [], timeout)
+        if not ready:
+            raise TimeoutError("snapshot incomplete, got %d of %d bytes" % (len(data), n))
+        data += os.read(fd, n - len(data))
+    return data
+
+
+def read_token(fd, timeout):
+    token = b""
+    while True:
+        c = read_exact(fd, 1, timeout)
+        if c.isspace():
+            if token:
+                return token
+        else:
+            token += c
+
+
+def receive(fd, timeout):
+    # Skip anything before the start of a snapshot
+    prev = b""
+    while True:
+        c = read_exact(fd, 1, None)
+        if prev + c in (b"P4", b"FB"):
+            break
+        prev = c
+
+    if prev + c == b"FB":
+        w, h = read_exact(fd, 2, timeout)
+        pages = read_exact(fd, w * ((h + 7) // 8), timeout)
+        rows = bytearray()
+        for y in range(h):
+            for bx in range((w + 7) // 8):
+                b = 0
+                for x in range(bx * 8, min(bx * 8 + 8, w)):
+                    if pages[x + (y // 8) * w] & (1 << (y & 7)):
+                        b |= 0x80 >> (x & 7)
+                rows.append(b)
+        return b"P4\n%d %d\n" % (w, h) + bytes(rows)
+
+    w = int(read_token(fd, timeout))
+    h = int(read_token(fd, timeout))
+    return b"P4\n%d %d\n" % (w, h) + read_exact(fd, h * ((w + 7) // 8), timeout)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("port", help="serial device or pty")
+    parser.add_argument("output", help="PBM file to write")
+    parser.add_argument("--baud", type=int, default=460800, choices=sorted(BAUDS))
+    parser.add_argument("--timeout", type=float, default=2.0, help="seconds allowed between bytes")
+    args = parser.parse_args()
+
+    fd = os.open(args.port, os.O_RDWR | os.O_NOCTTY)
+    if os.isatty(fd):
+        tty.setraw(fd)
+        attrs = termios.tcgetattr(fd)
+        attrs[4] = attrs[5] = BAUDS[args.baud]
+        termios.tcsetattr(fd, termios.TCSANOW, attrs)
+
+    image = receive(fd, args.timeout)
+    with open(args.output, "wb") as f:
+        f.write(image)
+    print("saved %s" % args.output, file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+"""Decode an event trace dump (TRACE_dump(), or 't' on the serial port in
+demo mode) into a timeline, see Core/Inc/TRACE.h.
+
+Event names are read from the TRACE_event_id_t enum in TRACE.h, so the
+decoder follows the firmware without changes.
+
+  trace_decode.py capture.txt
+  trace_decode.py --port /dev/ttyACM0
+"""
+
+import argparse
+import os
+import re
+import select
+import sys
+import termios
+import tty
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from rfb_send import BAUDS  # noqa: E402
+
+TRACE_H = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Core", "Inc", "TRACE.h")
+
+# Exception numbers of the handlers in stm32f3xx_it.c, 16 + IRQn
+CONTEXTS = {
+    0: "thread",
+    15: "systick",
+    30: "dma1_ch4",
+    32: "dma1_ch6",
+    33: "dma1_ch7",
+    47: "i2c1_ev",
+    48: "i2c1_er",
+    49: "i2c2_ev",
+    54: "usart2",
+    56: "exti15_10",
+    72: "dma2_ch1",
+}
+
+SCROLL = {0x26: "right", 0x27: "left", 0x29: "diag right", 0x2A: "diag left", 0x2E: "stop"}
+
+
+def event_names(path):
+    with open(path) as f:
+        text = f.read()
+    body = re.search(r"typedef enum\s*\{(.*?)\}\s*TRACE_event_id_t;", text, re.S).group(1)
+    names = re.findall(r"^\s*TRACE_(\w+)\s*,", body, re.M)
+    return {i: name for i, name in enumerate(names)}
+
+
+def describe(name, arg):
+    if name == "REPAINT":
+        return "full" if arg == 0xFFFF else "page %d" % arg
+    if name == "COMMAND":
+        return "0x%02X" % arg
+    if name == "SCROLL":
+        return SCROLL.get(arg, "0x%02X" % arg)
+    if name == "REPAINT_SKIP":
+        return "pages 0x%02X" % arg
+    if name == "I2C_ERROR":
+        return "error 0x%X" % arg
+    if name in ("DMA_START", "MARK", "START_LINE", "FRAME_DROP", "RX_DROP"):
+        return str(arg)
+    return ""
+
+
+def parse(lines):
+    """Return (cpu_hz, [(cycles, event, context, arg)]) of the last dump."""
+    hz, events, dump = None, [], None
+    for line in lines:
+        m = re.match(r"\s*trace: (.*)", line)
+        if not m:
+            continue
+        fields = m.group(1).split()
+        if fields[0] == "begin":
+            hz, dump = int(fields[2]), []
+        elif fields[0] == "end":
+            if dump is not None:
+                events = dump
+            dump = None
+        elif dump is not None and len(fields) == 4:
+            dump.append((int(fields[0], 16), int(fields[1]), int(fields[2]), int(fields[3])))
+    if hz is None:
+        raise ValueError("no trace dump found")
+    return hz, events
+
+
+def timeline(hz, events, names):
+    out = []
+    t, prev = 0, None
+    for cycles, event, context, arg in events:
+        if prev is not None:
+            delta = (cycles - prev) & 0xFFFFFFFF
+            # Events claim their slot before reading the clock, an interrupt
+            # in between shows up slightly out of order
+            if delta >= 0x80000000:
+                delta -= 0x100000000
+            t += delta
+        prev = cycles
+        name = names.get(event, "EVENT_%d" % event)
+        ctx = CONTEXTS.get(context, "irq%d" % (context - 16))
+        out.append(("%12.1f us  %-9s %-11s %s" % (t * 1e6 / hz, ctx, name, describe(name, arg))).rstrip())
+    return out
+
+
+def capture(port, baud, timeout):
+    fd = os.open(port, os.O_RDWR | os.O_NOCTTY)
+    if os.isatty(fd):
+        tty.setraw(fd)
+        attrs = termios.tcgetattr(fd)
+        attrs[4] = attrs[5] = BAUDS[baud]
+        termios.tcsetattr(fd, termios.TCSANOW, attrs)
+
+    os.write(fd, b"t")
+    data = b""
+    while b"trace: end" not in data:
+        ready, _, _ = select.select([fd], [], [], timeout)
+        if not ready:
+            raise TimeoutError("trace dump incomplete")
+        data += os.read(fd, 4096)
+    os.close(fd)
+    return data.decode("ascii", "replace").splitlines()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", nargs="?", help="captured serial output, stdin if omitted")
+    parser.add_argument("--port", help="request a dump from this serial device instead")
+    parser.add_argument("--baud", type=int, default=460800, choices=sorted(BAUDS))
+    parser.add_argument("--timeout", type=float, default=2.0, help="seconds allowed between bytes")
+    parser.add_argument("--header", default=TRACE_H, help="TRACE.h to take event names from")
+    args = parser.parse_args()
+
+    if args.port:
+        lines = capture(args.port, args.baud, args.timeout)
+    elif args.input:
+        with open(args.input) as f:
+            lines = f.read().splitlines()
+    else:
+        lines = sys.stdin.read().splitlines()
+
+    hz, events = parse(lines)
+    for line in timeline(hz, events, event_names(args.header)):
+        print(line)
+    print("%d events" % len(events), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,564 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Randomised differential test of the optimised drawing paths. Every
+ * batch of random operations is drawn three times from the same random
+ * starting frame: with GFX_set_fast_paths(true), with it false, and by a
+ * reference that only calls SSD1306_draw_pixel(). The frame buffers must
+ * match byte for byte.
+ *
+ * Fills, glyphs (from the cache and freshly decoded, size 1 to 3) and
+ * rectangle blits are drawn in all rotations and colors, at positions
+ * hanging off every edge.
+ *
+ * Every frame is then repainted, with the mirroring cycling through its
+ * four settings, into a model of the panel fed through
+ * SSD1306_set_host_write(). The hashes of the frames as drawn, packed
+ * with SNAPSHOT_pack_rows(), and as shown on the panel are printed per
+ * rotation. Builds with SSD1306_HW_ROTATION=0 or SSD1306_TRANSPOSE_FLUSH=1
+ * must print the same, the Makefile compares them.
+ *
+ *   fast_paths [frames per rotation] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "GFX.h"
+#include "SNAPSHOT.h"
+#include "font_ascii_5x7.h"
+
+#define BUFFER_SIZE (SSD1306_WIDTH * ((SSD1306_HEIGHT + 7) / 8))
+#define OPS_PER_FRAME 6
+#define MARGIN 24		// Positions range this far past each edge
+#define PAGES ((SSD1306_HEIGHT + 7) / 8)
+
+typedef enum
+{
+	OP_FILL,
+	OP_CHAR,
+	OP_STRING,
+	OP_BLIT,
+	OP_KINDS
+} op_kind_t;
+
+typedef struct
+{
+	op_kind_t kind;
+	int16_t x, y, w, h;		// Blit: source column and page, size in columns and pages
+	int16_t dx, dpage;		// Blit destination
+	uint16_t color, bg;
+	uint8_t size_x, size_y;
+	unsigned char text[4];
+	bool flush;				// Start from an empty glyph cache
+} op_t;
+
+typedef enum
+{
+	PATH_FAST,
+	PATH_SLOW,
+	PATH_REFERENCE,
+	PATHS
+} path_t;
+
+/* The controller as far as the picture goes, horizontal addressing only */
+typedef struct
+{
+	uint8_t ram[PAGES][SSD1306_WIDTH];
+	uint8_t col_start, col_end, page_start, page_end, col, page;
+	uint8_t start_line;
+	bool seg_remap, com_dec;
+	uint8_t cmd[7];			// Command being collected, with its arguments
+	uint8_t cmd_len, cmd_args;
+} panel_t;
+
+static const char * const path_names[PATHS] = {"fast", "slow", "reference"};
+static const uint16_t colors[3] = {SSD1306_WHITE, SSD1306_BLACK, SSD1306_INVERSE};
+static uint32_t rng;
+static panel_t panel;
+
+static uint32_t rand32(void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+static int16_t rand_range(int16_t lo, int16_t hi)
+{
+	return lo + (int16_t)(rand32() % (uint32_t)(hi - lo + 1));
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t hash(uint32_t h, const uint8_t *data, uint16_t len)
+{
+	while (len--)
+	{
+		h = (h ^ *data++) * 16777619UL;		// FNV-1a
+	}
+	return h;
+}
+
+/* Argument bytes following a command */
+static uint8_t panel_args(uint8_t c)
+{
+	switch (c)
+	{
+		case SSD1306_MEMORYMODE:
+		case SSD1306_SETCONTRAST:
+		case SSD1306_CHARGEPUMP:
+		case SSD1306_SETMULTIPLEX:
+		case SSD1306_SETDISPLAYOFFSET:
+		case SSD1306_SETDISPLAYCLOCKDIV:
+		case SSD1306_SETPRECHARGE:
+		case SSD1306_SETCOMPINS:
+		case SSD1306_SETVCOMDETECT:
+			return 1;
+		case SSD1306_COLUMNADDR:
+		case SSD1306_PAGEADDR:
+		case SSD1306_SET_VERTICAL_SCROLL_AREA:
+			return 2;
+		case SSD1306_VERTICAL_AND_RIGHT_HORIZONTAL_SCROLL:
+		case SSD1306_VERTICAL_AND_LEFT_HORIZONTAL_SCROLL:
+			return 5;
+		case SSD1306_RIGHT_HORIZONTAL_SCROLL:
+		case SSD1306_LEFT_HORIZONTAL_SCROLL:
+			return 6;
+		default:
+			return 0;
+	}
+}
+
+static void panel_command(const uint8_t *cmd)
+{
+	switch (cmd[0])
+	{
+		case SSD1306_COLUMNADDR:
+			panel.col = panel.col_start = cmd[1];
+			panel.col_end = cmd[2];
+			break;
+		case SSD1306_PAGEADDR:
+			panel.page = panel.page_start = cmd[1];
+			panel.page_end = cmd[2];
+			break;
+		case SSD1306_SEGREMAP:
+		case SSD1306_SEGREMAP | 0x01:
+			panel.seg_remap = cmd[0] & 0x01;
+			break;
+		case SSD1306_COMSCANINC:
+		case SSD1306_COMSCANDEC:
+			panel.com_dec = (cmd[0] == SSD1306_COMSCANDEC);
+			break;
+		default:
+			if ((cmd[0] & 0xC0) == SSD1306_SETSTARTLINE)
+			{
+				panel.start_line = cmd[0] & 0x3F;
+			}
+			break;
+	}
+}
+
+static void panel_write(uint8_t reg, const uint8_t *buf, uint16_t len)
+{
+	while (len--)
+	{
+		if (reg == SSD1306_SETSTARTLINE)
+		{
+			// Display data, wraps around the address window
+			panel.ram[panel.page][panel.col] = *buf++;
+			if (panel.col++ >= panel.col_end)
+			{
+				panel.col = panel.col_start;
+				panel.page = (panel.page >= panel.page_end) ? panel.page_start : panel.page + 1;
+			}
+			continue;
+		}
+		panel.cmd[panel.cmd_len++] = *buf++;
+		if (panel.cmd_len == 1)
+		{
+			panel.cmd_args = panel_args(panel.cmd[0]);
+		}
+		if (panel.cmd_len > panel.cmd_args)
+		{
+			panel_command(panel.cmd);
+			panel.cmd_len = 0;
+		}
+	}
+}
+
+/* The picture as the rows and columns of the glass show it, MSB leftmost */
+static void panel_view(uint8_t view[SSD1306_HEIGHT][SSD1306_WIDTH / 8])
+{
+	int16_t r, s, line, col;
+
+	memset(view, 0, SSD1306_HEIGHT * SSD1306_WIDTH / 8);
+	for (r = 0; r < SSD1306_HEIGHT; r++)
+	{
+		line = ((panel.com_dec ? SSD1306_HEIGHT - 1 - r : r) + panel.start_line) % SSD1306_HEIGHT;
+		for (s = 0; s < SSD1306_WIDTH; s++)
+		{
+			col = panel.seg_remap ? SSD1306_WIDTH - 1 - s : s;
+			if (panel.ram[line / 8][col] & (1 << (line & 7)))
+			{
+				view[r][s / 8] |= 0x80 >> (s & 7);
+			}
+		}
+	}
+}
+
+static bool view_pixel(uint8_t view[SSD1306_HEIGHT][SSD1306_WIDTH / 8], int16_t r, int16_t s)
+{
+	return view[r][s / 8] & (0x80 >> (s & 7));
+}
+
+static void random_op(op_t *op, int16_t width, int16_t height)
+{
+	uint8_t i;
+
+	memset(op, 0, sizeof(*op));
+	op->kind = rand32() % OP_KINDS;
+	op->color = colors[rand32() % 3];
+	// A quarter of the text is transparent, the rest has some background
+	op->bg = (rand32() & 3) ? colors[rand32() % 3] : op->color;
+	op->size_x = rand_range(1, 3);
+	op->size_y = (rand32() & 7) ? rand_range(1, 2) : 3;
+	op->flush = (rand32() & 15) == 0;
+	op->x = rand_range(-MARGIN, width + MARGIN);
+	op->y = rand_range(-MARGIN, height + MARGIN);
+	op->w = rand_range(0, width / 2);
+	op->h = rand_range(0, height / 2);
+	for (i = 0; i < sizeof(op->text) - 1; i++)
+	{
+		// Few distinct glyphs, so the cache hits as well as misses
+		op->text[i] = (rand32() & 1) ? 'A' + rand32() % 4 : rand32() & 0xFF;
+	}
+	if (op->kind == OP_BLIT)
+	{
+		// Buffer layout, a canvas is SSD1306_HEIGHT columns wide
+		width = SSD1306_get_buffer_width();
+		height = BUFFER_SIZE / width;
+		op->w = rand_range(1, width);
+		op->h = rand_range(1, height);
+		op->x = rand_range(0, width - op->w);
+		op->y = rand_range(0, height - op->h);
+		op->dx = rand_range(0, width - op->w);
+		op->dpage = rand_range(0, height - op->h);
+	}
+}
+
+static void ref_fill_rect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+	int16_t i, j;
+
+	for (i = x; i < x + w; i++)
+	{
+		for (j = y; j < y + h; j++)
+		{
+			SSD1306_draw_pixel(i, j, color);
+		}
+	}
+}
+
+/* GFX_draw_char() spelled out pixel by pixel */
+static void ref_draw_char(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size_x, uint8_t size_y)
+{
+	int8_t i, j;
+	uint8_t line;
+
+	for (i = 0; i < 5; i++)
+	{
+		line = font[c * 5 + i];
+		for (j = 7; j >= 0; j--, line >>= 1)
+		{
+			if (line & 1)
+			{
+				ref_fill_rect(x + i * size_x, y + j * size_y, size_x, size_y, color);
+			}
+			else if (bg != color)
+			{
+				ref_fill_rect(x + i * size_x, y + j * size_y, size_x, size_y, bg);
+			}
+		}
+	}
+	if (bg != color)
+	{
+		ref_fill_rect(x + 5 * size_x, y, size_x, 8 * size_y, bg);
+	}
+}
+
+/* Blits work on the buffer layout, copy bit by bit */
+static void ref_blit(const op_t *op)
+{
+	static bool pixels[BUFFER_SIZE * 8];
+	uint8_t *buffer = SSD1306_get_buffer(), *b;
+	int16_t width = SSD1306_get_buffer_width(), i, j;
+
+	for (i = 0; i < op->w; i++)
+	{
+		for (j = 0; j < op->h * 8; j++)
+		{
+			b = &buffer[(op->y + j / 8) * width + op->x + i];
+			pixels[j * op->w + i] = *b & (1 << (j & 7));
+		}
+	}
+	for (i = 0; i < op->w; i++)
+	{
+		for (j = 0; j < op->h * 8; j++)
+		{
+			b = &buffer[(op->dpage + j / 8) * width + op->dx + i];
+			*b = pixels[j * op->w + i] ? (*b | (1 << (j & 7))) : (*b & ~(1 << (j & 7)));
+		}
+	}
+}
+
+static void run_op(const op_t *op, path_t path)
+{
+	uint8_t save[BUFFER_SIZE];
+	uint8_t i;
+
+	if (op->flush)
+	{
+		GFX_glyph_cache_flush();
+	}
+	switch (op->kind)
+	{
+		case OP_FILL:
+			if (path == PATH_REFERENCE)
+			{
+				ref_fill_rect(op->x, op->y, op->w, op->h, op->color);
+			}
+			else
+			{
+				GFX_draw_fill_rect(op->x, op->y, op->w, op->h, op->color);
+			}
+			break;
+		case OP_CHAR:
+			if (path == PATH_REFERENCE)
+			{
+				ref_draw_char(op->x, op->y, op->text[0], op->color, op->bg, op->size_x, op->size_y);
+			}
+			else
+			{
+				GFX_draw_char(op->x, op->y, op->text[0], op->color, op->bg, op->size_x, op->size_y);
+			}
+			break;
+		case OP_STRING:
+			if (path == PATH_REFERENCE)
+			{
+				for (i = 0; op->text[i]; i++)
+				{
+					ref_draw_char(op->x + i * GFX_CHAR_ADVANCE * op->size_x, op->y, op->text[i], op->color, op->bg, op->size_x, op->size_y);
+				}
+			}
+			else
+			{
+				GFX_draw_string(op->x, op->y, (unsigned char *)op->text, op->color, op->bg, op->size_x, op->size_y);
+			}
+			break;
+		case OP_BLIT:
+			if (path == PATH_REFERENCE)
+			{
+				ref_blit(op);
+			}
+			else
+			{
+				SSD1306_save_rect(save, op->x, op->y, op->w, op->h, NULL, NULL);
+				SSD1306_restore_rect(save, op->dx, op->dpage, op->w, op->h, NULL, NULL);
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+/*
+ * Draw random frames through the fast paths and hash them as drawn and as
+ * shown on the panel, per rotation. The frames start from random pixels
+ * and leave out blits, which both work on the buffer layout. Mirroring
+ * must flip what the panel shows and nothing else.
+ */
+static bool hash_frames(unsigned long frames)
+{
+	static uint8_t image[SSD1306_WIDTH * PAGES];
+	static uint8_t plain[SSD1306_HEIGHT][SSD1306_WIDTH / 8], mirrored[SSD1306_HEIGHT][SSD1306_WIDTH / 8];
+	uint32_t snapshot_sum, panel_sum;
+	unsigned long f;
+	int16_t width, height, x, y;
+	uint8_t rotation, i;
+	bool mirror_x, mirror_y;
+	op_t op;
+
+	GFX_set_fast_paths(true);
+	for (rotation = 0; rotation < 4; rotation++)
+	{
+		SSD1306_set_rotation(rotation);
+		width = (rotation & 1) ? SSD1306_HEIGHT : SSD1306_WIDTH;
+		height = (rotation & 1) ? SSD1306_WIDTH : SSD1306_HEIGHT;
+		snapshot_sum = panel_sum = 2166136261UL;
+		for (f = 0; f < frames; f++)
+		{
+			for (y = 0; y < height; y++)
+			{
+				for (x = 0; x < width; x++)
+				{
+					SSD1306_draw_pixel(x, y, rand32() & 1);
+				}
+			}
+			for (i = 0; i < OPS_PER_FRAME; i++)
+			{
+				do
+				{
+					random_op(&op, width, height);
+				} while (op.kind == OP_BLIT);
+				run_op(&op, PATH_FAST);
+			}
+
+			snapshot_sum = hash(snapshot_sum, image, SNAPSHOT_pack_rows(0, SSD1306_WIDTH, image));
+			SSD1306_display_repaint();
+			panel_view(plain);
+			panel_sum = hash(panel_sum, plain[0], sizeof(plain));
+
+			mirror_x = f & 1;
+			mirror_y = f & 2;
+			SSD1306_set_mirror(mirror_x, mirror_y);
+			panel_view(mirrored);
+			SSD1306_set_mirror(false, false);
+			for (y = 0; y < SSD1306_HEIGHT; y++)
+			{
+				for (x = 0; x < SSD1306_WIDTH; x++)
+				{
+					if (view_pixel(mirrored, y, x) != view_pixel(plain, mirror_y ? SSD1306_HEIGHT - 1 - y : y, mirror_x ? SSD1306_WIDTH - 1 - x : x))
+					{
+						printf("FAIL: mirror x %d y %d does not flip the panel, rotation %u frame %lu, row %d column %d\n",
+								mirror_x, mirror_y, rotation, f, y, x);
+						return false;
+					}
+				}
+			}
+		}
+		printf("fast_paths: rotation %u snapshots %08x panel %08x\n", rotation, (unsigned)snapshot_sum, (unsigned)panel_sum);
+	}
+	return true;
+}
+
+static void print_op(const op_t *op)
+{
+	static const char * const kinds[OP_KINDS] = {"fill", "char", "string", "blit"};
+
+	printf("  %s x %d y %d w %d h %d dx %d dpage %d color %u bg %u size %ux%u text %02x %02x %02x flush %d\n",
+			kinds[op->kind], op->x, op->y, op->w, op->h, op->dx, op->dpage, op->color, op->bg,
+			op->size_x, op->size_y, op->text[0], op->text[1], op->text[2], op->flush);
+}
+
+int main(int argc, char **argv)
+{
+	static uint8_t start[BUFFER_SIZE], result[PATHS][BUFFER_SIZE];
+	op_t ops[OPS_PER_FRAME];
+	double elapsed[PATHS] = {0}, t;
+	unsigned long frames = (argc > 1) ? strtoul(argv[1], NULL, 0) : 2000, f;
+	uint32_t seed = (argc > 2) ? strtoul(argv[2], NULL, 0) : 0x5EED1306;
+	GFX_glyph_cache_stats_t cache;
+	uint8_t *buffer, rotation, p, i;
+	uint16_t b;
+
+	SSD1306_set_host_write(panel_write);
+	if (!SSD1306_init())
+	{
+		fprintf(stderr, "SSD1306_init failed\n");
+		return 1;
+	}
+	buffer = SSD1306_get_buffer();
+	rng = seed ? seed : 1;
+	printf("fast_paths: seed 0x%08x, %lu frames of %u operations per rotation\n", (unsigned)seed, frames, OPS_PER_FRAME);
+	printf("fast_paths: SSD1306_HW_ROTATION %d SSD1306_TRANSPOSE_FLUSH %d\n", SSD1306_HW_ROTATION, SSD1306_TRANSPOSE_FLUSH);
+
+	for (rotation = 0; rotation < 4; rotation++)
+	{
+		SSD1306_set_rotation(rotation);
+		for (f = 0; f < frames; f++)
+		{
+			for (b = 0; b < BUFFER_SIZE; b++)
+			{
+				start[b] = rand32();
+			}
+			for (i = 0; i < OPS_PER_FRAME; i++)
+			{
+				random_op(&ops[i], (rotation & 1) ? SSD1306_HEIGHT : SSD1306_WIDTH, (rotation & 1) ? SSD1306_WIDTH : SSD1306_HEIGHT);
+			}
+
+			for (p = 0; p < PATHS; p++)
+			{
+				memcpy(buffer, start, BUFFER_SIZE);
+				GFX_set_fast_paths(p == PATH_FAST);
+				t = now();
+				for (i = 0; i < OPS_PER_FRAME; i++)
+				{
+					run_op(&ops[i], p);
+				}
+				elapsed[p] += now() - t;
+				memcpy(result[p], buffer, BUFFER_SIZE);
+			}
+
+			for (p = PATH_FAST; p < PATH_REFERENCE; p++)
+			{
+				for (b = 0; b < BUFFER_SIZE; b++)
+				{
+					if (result[p][b] != result[PATH_REFERENCE][b])
+					{
+						printf("FAIL: %s path differs from the reference, rotation %u frame %lu, byte %u (page %u column %u) %02x != %02x\n",
+								path_names[p], rotation, f, b, b / SSD1306_get_buffer_width(), b % SSD1306_get_buffer_width(),
+								result[p][b], result[PATH_REFERENCE][b]);
+						for (i = 0; i < OPS_PER_FRAME; i++)
+						{
+							print_op(&ops[i]);
+						}
+						return 1;
+					}
+				}
+			}
+		}
+	}
+
+	if (!hash_frames(frames / 4 + 1))
+	{
+		return 1;
+	}
+	GFX_glyph_cache_get_stats(&cache);
+	for (p = 0; p < PATHS; p++)
+	{
+		printf("fast_paths: %-9s %8.2f ms\n", path_names[p], elapsed[p] * 1e3);
+	}
+	printf("fast_paths: glyph cache hits %u misses %u evictions %u\n", (unsigned)cache.hits, (unsigned)cache.misses, (unsigned)cache.evictions);
+	printf("fast_paths: ok\n");
+	return 0;
+}
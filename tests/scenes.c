@@ -0,0 +1,180 @@
+/* The MIT License
+ *
+ * Copyright (c) 2020 Piotr Duba
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Golden image scenes, drawn through the real GFX and SSD1306 code and
+ * saved with SNAPSHOT_save(). The Makefile compares each against the
+ * checked in tests/golden/<name>.pbm with Tools/pbm_diff.py.
+ *
+ *   scenes <output directory>
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "GFX.h"
+#include "SNAPSHOT.h"
+#include "TERM.h"
+
+typedef struct
+{
+	const char *name;
+	void (*draw)(void);
+} scene_t;
+
+/* Characters at both sizes, transparent and opaque, across page boundaries */
+static void scene_char(void)
+{
+	GFX_draw_char(0, 0, 'A', SSD1306_WHITE, SSD1306_WHITE, 1, 1);
+	GFX_draw_char(8, 3, 'g', SSD1306_WHITE, SSD1306_BLACK, 1, 1);
+	GFX_draw_char(16, 13, '@', SSD1306_WHITE, SSD1306_WHITE, 2, 2);
+	GFX_draw_char(32, 20, 'Q', SSD1306_WHITE, SSD1306_BLACK, 2, 1);
+	GFX_draw_fill_rect(48, 0, 40, 30, SSD1306_WHITE);
+	GFX_draw_char(50, 5, 'x', SSD1306_BLACK, SSD1306_BLACK, 1, 1);
+	GFX_draw_char(60, 9, 'Z', SSD1306_INVERSE, SSD1306_INVERSE, 2, 2);
+	GFX_draw_char(-3, 40, 'M', SSD1306_WHITE, SSD1306_BLACK, 1, 1);
+	GFX_draw_char(123, 60, 'W', SSD1306_WHITE, SSD1306_BLACK, 2, 2);
+	GFX_draw_char(100, 30, 0x03, SSD1306_WHITE, SSD1306_WHITE, 3, 3);
+}
+
+/* Strings, including one rotated and one running off the right edge */
+static void scene_string(void)
+{
+	GFX_draw_string(0, 0, (unsigned char *)"Hello, world!", SSD1306_WHITE, SSD1306_WHITE, 1, 1);
+	GFX_draw_string(2, 11, (unsigned char *)"0123456789", SSD1306_WHITE, SSD1306_BLACK, 1, 1);
+	GFX_draw_string(4, 22, (unsigned char *)"Big text!", SSD1306_WHITE, SSD1306_BLACK, 2, 2);
+	GFX_draw_string(0, 45, (unsigned char *)"tall", SSD1306_WHITE, SSD1306_WHITE, 1, 2);
+	SSD1306_set_rotation(1);
+	GFX_draw_string(0, 0, (unsigned char *)"Rot", SSD1306_WHITE, SSD1306_BLACK, 1, 1);
+	SSD1306_set_rotation(0);
+}
+
+/* Rectangles in all three colors, overlapping and clipped at every edge */
+static void scene_fill_rect(void)
+{
+	GFX_draw_fill_rect(2, 2, 30, 20, SSD1306_WHITE);
+	GFX_draw_fill_rect(10, 7, 12, 9, SSD1306_BLACK);
+	GFX_draw_fill_rect(20, 12, 40, 17, SSD1306_INVERSE);
+	GFX_draw_fill_rect(-5, 40, 15, 30, SSD1306_WHITE);
+	GFX_draw_fill_rect(120, -6, 20, 13, SSD1306_WHITE);
+	GFX_draw_fill_rect(64, 33, 1, 1, SSD1306_WHITE);
+	GFX_draw_fill_rect(70, 33, 50, 0, SSD1306_WHITE);
+	GFX_draw_fill_rect(80, 40, 30, 3, SSD1306_INVERSE);
+}
+
+/*
+ * Vertical lines through SSD1306_draw_fast_vline_internal(): within one
+ * page, spanning several, clipped at the top and bottom and left and
+ * right of the buffer, and rotated so horizontal lines end up there.
+ */
+static void scene_vline_clip(void)
+{
+	int16_t i;
+
+	for (i = 0; i < 8; i++)
+	{
+		SSD1306_draw_fast_vline(2 + 2 * i, i, 1 + i, SSD1306_WHITE);
+		SSD1306_draw_fast_vline(20 + 2 * i, 3 + i, 17 + 3 * i, SSD1306_WHITE);
+		SSD1306_draw_fast_vline(40 + 2 * i, -9 + i, 12 + i, SSD1306_WHITE);
+		SSD1306_draw_fast_vline(60 + 2 * i, 50 + i, 30, SSD1306_WHITE);
+	}
+	SSD1306_draw_fast_vline(-1, 0, 64, SSD1306_WHITE);
+	SSD1306_draw_fast_vline(128, 0, 64, SSD1306_WHITE);
+	SSD1306_draw_fast_vline(80, -100, 300, SSD1306_WHITE);
+	SSD1306_draw_fast_vline(80, 10, 20, SSD1306_INVERSE);
+	SSD1306_draw_fast_vline(80, 40, 5, SSD1306_BLACK);
+	SSD1306_set_rotation(1);
+	SSD1306_draw_fast_hline(-4, 100, 30, SSD1306_WHITE);
+	SSD1306_set_rotation(3);
+	SSD1306_draw_fast_hline(50, 10, 30, SSD1306_WHITE);
+	SSD1306_set_rotation(0);
+}
+
+static void term_print(const char *s)
+{
+	TERM_feed((const uint8_t *)s, strlen(s));
+}
+
+/*
+ * Terminal erase to the cursor, ESC[1J and ESC[1K, right after a full
+ * row, while the wrap is pending and the cursor is past the last column.
+ * The J and K below the erased rows must survive.
+ */
+static void scene_term(void)
+{
+	char row[TERM_COLUMNS + 1];
+	uint8_t i;
+
+	for (i = 0; i < TERM_COLUMNS; i++)
+	{
+		row[i] = 'A' + i;
+	}
+	row[TERM_COLUMNS] = '\0';
+	TERM_init();
+	term_print("\x1b[4;1HJ\x1b[3;1H");
+	term_print(row);
+	term_print("\x1b[1J\x1b[7;1HK\x1b[6;1H");
+	term_print(row);
+	term_print("\x1b[1K\x1b[1;1H\x1b[7m1J\x1b[27m rows 1-3\x1b[5;1H\x1b[7m1K\x1b[27m row 6");
+	TERM_render();
+}
+
+static const scene_t scenes[] =
+{
+	{"char", scene_char},
+	{"string", scene_string},
+	{"fill_rect", scene_fill_rect},
+	{"vline_clip", scene_vline_clip},
+	{"term", scene_term},
+};
+
+int main(int argc, char **argv)
+{
+	char path[256];
+	unsigned int i;
+
+	if (argc != 2)
+	{
+		fprintf(stderr, "usage: %s <output directory>\n", argv[0]);
+		return 2;
+	}
+	if (!SSD1306_init())
+	{
+		fprintf(stderr, "SSD1306_init failed\n");
+		return 1;
+	}
+
+	for (i = 0; i < sizeof(scenes) / sizeof(scenes[0]); i++)
+	{
+		// Every scene starts unrotated, whatever the init default is
+		SSD1306_set_rotation(0);
+		SSD1306_display_clear();
+		scenes[i].draw();
+		snprintf(path, sizeof(path), "%s/%s.pbm", argv[1], scenes[i].name);
+		if (!SNAPSHOT_save(path, SNAPSHOT_FORMAT_PBM))
+		{
+			fprintf(stderr, "cannot write %s\n", path);
+			return 1;
+		}
+	}
+	return 0;
+}